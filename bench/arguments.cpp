@@ -0,0 +1,69 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "arguments.h"
+
+#include <sstream>
+#include <stdexcept>
+
+namespace bench
+{
+
+Arguments::Arguments(int argc, char** argv)
+{
+    for(int i = 1; i < argc; i += 2)
+    {
+        const auto name = std::string(argv[i]);
+        if(name.substr(0, 2) != "--" or i + 1 == argc) throw std::invalid_argument("expected --name value, got " + name);
+
+        values[name.substr(2)] = argv[i + 1];
+    }
+}
+
+std::string Arguments::text(const std::string& name, const std::string& fallback) const
+{
+    const auto iter = values.find(name);
+    return iter == values.end() ? fallback : iter->second;
+}
+
+double Arguments::number(const std::string& name, double fallback) const
+{
+    const auto iter = values.find(name);
+    if(iter == values.end()) return fallback;
+
+    size_t     end    = 0;
+    const auto result = std::stod(iter->second, &end);
+    if(end != iter->second.size()) throw std::invalid_argument("--" + name + " has to be a number");
+    return result;
+}
+
+std::vector<size_t> Arguments::numbers(const std::string& name, const std::vector<size_t>& fallback) const
+{
+    const auto iter = values.find(name);
+    if(iter == values.end()) return fallback;
+
+    std::vector<size_t> result;
+    std::istringstream  stream(iter->second);
+    for(std::string part; std::getline(stream, part, ',');) result.push_back(std::stoul(part));
+    return result;
+}
+
+FleetOptions Arguments::fleet(FleetOptions defaults) const
+{
+    defaults.bulbs         = static_cast<size_t>(number("bulbs", static_cast<double>(defaults.bulbs)));
+    defaults.ssdp_ip       = text("ssdp-ip", defaults.ssdp_ip);
+    defaults.ssdp_port     = static_cast<uint16_t>(number("ssdp-port", defaults.ssdp_port));
+    defaults.first_ip      = text("first-ip", defaults.first_ip);
+    defaults.tcp_port      = static_cast<uint16_t>(number("tcp-port", defaults.tcp_port));
+    defaults.latency       = std::chrono::microseconds(static_cast<int64_t>(number("latency-us", static_cast<double>(defaults.latency.count()))));
+    defaults.jitter        = std::chrono::microseconds(static_cast<int64_t>(number("jitter-us", static_cast<double>(defaults.jitter.count()))));
+    defaults.loss          = number("loss", defaults.loss);
+    defaults.fragment      = static_cast<size_t>(number("fragment", static_cast<double>(defaults.fragment)));
+    defaults.answer_window = std::chrono::milliseconds(static_cast<int64_t>(number("window-ms", static_cast<double>(defaults.answer_window.count()))));
+    return defaults;
+}
+
+} // namespace bench
@@ -0,0 +1,42 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+
+#include "fleet.h"
+
+namespace bench
+{
+
+// The command line as --name value pairs.
+class Arguments
+{
+    public:
+    // throws std::invalid_argument for anything that is not a pair
+    Arguments(int argc, char** argv);
+
+    [[nodiscard]] std::string text(const std::string& name, const std::string& fallback) const;
+
+    // throws std::invalid_argument if the value is not a number
+    [[nodiscard]] double number(const std::string& name, double fallback) const;
+
+    // a comma separated list like 10,100,1000
+    [[nodiscard]] std::vector<size_t> numbers(const std::string& name, const std::vector<size_t>& fallback) const;
+
+    // --bulbs, --ssdp-ip, --ssdp-port, --first-ip, --tcp-port, --latency-us,
+    // --jitter-us, --loss, --fragment and --window-ms, the rest is left at the defaults
+    [[nodiscard]] FleetOptions fleet(FleetOptions defaults = FleetOptions()) const;
+
+    private:
+    std::map<std::string, std::string> values;
+};
+
+} // namespace bench
@@ -0,0 +1,192 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Finds a simulated fleet with the scanner and keeps every bulb busy for a
+// while, once for every fleet size and number of scanner threads. Commands are
+// dispatched, so they skip the pacing of the queue and measure the network path
+// itself. The ack latency is from writing the command to its answer, connecting
+// is not part of it.
+// yeelight_bench --sizes 10,100,1000 --threads 1,2,4,8 --seconds 5 --depth 4 --latency-us 2000
+
+#include "arguments.h"
+#include "fleet.h"
+
+#include "yeelight/scanner.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+struct Result
+{
+    size_t               bulbs   = 0;
+    size_t               threads = 0;
+    clock::duration      discovery{};
+    double               per_second = 0;
+    std::vector<int64_t> latencies; // microseconds, of every answered command
+    uint64_t             failed = 0;
+    bool                 found  = false;
+};
+
+// every bulb has this many commands going at any time
+struct Load
+{
+    yeelight::Device*     device = nullptr;
+    std::vector<int64_t>  latencies;
+    uint64_t              failed = 0;
+    std::atomic<uint64_t> sent   = 0; // the first commands go out from the main thread
+};
+
+int64_t percentile(const std::vector<int64_t>& sorted, double fraction)
+{
+    if(sorted.empty()) return 0;
+    return sorted[std::min(sorted.size() - 1, static_cast<size_t>(fraction * static_cast<double>(sorted.size())))];
+}
+
+Result run(const bench::Arguments& arguments, size_t size, size_t threads)
+{
+    auto options  = arguments.fleet();
+    options.bulbs = size;
+
+    const auto seconds = std::chrono::duration<double>(arguments.number("seconds", 5));
+    const auto depth   = static_cast<size_t>(arguments.number("depth", 4));
+
+    yeelight::ScannerOptions scanner_options;
+    scanner_options.multicast_ip   = options.ssdp_ip;
+    scanner_options.multicast_port = options.ssdp_port;
+    scanner_options.idle_timeout   = std::chrono::minutes(10);
+    scanner_options.path           = std::filesystem::temp_directory_path() / "yeelight_bench.bin";
+    scanner_options.legacy_path    = std::filesystem::path();
+    scanner_options.thread_count   = threads;
+
+    // a registry would make every bulb known before the first search
+    std::filesystem::remove(scanner_options.path);
+
+    Result result;
+    result.bulbs   = size;
+    result.threads = threads;
+
+    auto fleet = bench::FakeFleet(options);
+
+    std::mutex                                     mutex;
+    std::condition_variable                        found;
+    std::vector<std::unique_ptr<yeelight::Device>> devices;
+
+    const auto handler = [&](std::unique_ptr<yeelight::Device> device) {
+        const auto lock = std::lock_guard(mutex);
+        devices.emplace_back(std::move(device));
+        if(devices.size() == size) found.notify_all();
+    };
+
+    const auto start   = clock::now();
+    auto       scanner = std::make_unique<yeelight::Scanner>(handler, scanner_options);
+    {
+        auto lock        = std::unique_lock(mutex);
+        result.found     = found.wait_for(lock, std::chrono::seconds(30), [&]() { return devices.size() >= size; });
+        result.discovery = clock::now() - start;
+    }
+    if(not result.found)
+    {
+        scanner = nullptr;
+        return result;
+    }
+
+    std::vector<Load> loads(devices.size());
+    std::atomic<bool>   running     = true;
+    std::atomic<size_t> outstanding = 0;
+
+    // The answers of a device all come in on its strand, so only that strand touches the
+    // latencies and failures. Commands are sent from there and from the main thread at the start.
+    std::function<void(Load&)> issue = [&](Load& load) {
+        const auto callback = [&](const yeelight::Response& response) {
+            if(response.error == yeelight::Error::none)
+                load.latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(response.latency).count());
+            else
+                load.failed++;
+
+            if(running) issue(load);
+            outstanding--;
+        };
+
+        const auto level = 1 + load.sent++ % 100;
+
+        outstanding++;
+        load.device->dispatch({ yeelight::make_command(yeelight::method::set_bright, callback, level, "sudden", 0) });
+    };
+
+    const auto begin = clock::now();
+    for(size_t i = 0; i < loads.size(); i++)
+    {
+        loads[i].device = devices[i].get();
+        for(size_t j = 0; j < depth; j++) issue(loads[i]);
+    }
+
+    std::this_thread::sleep_for(seconds);
+    running = false;
+
+    // whatever is still going is answered or times out within the operation timeout
+    const auto drained = clock::now() + std::chrono::seconds(5);
+    while(outstanding != 0 and clock::now() < drained) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    const auto elapsed = std::chrono::duration<double>(clock::now() - begin).count();
+
+    // a command that is still going after the drain can answer until the threads are joined
+    scanner = nullptr;
+
+    for(const auto& load : loads)
+    {
+        result.latencies.insert(result.latencies.end(), load.latencies.begin(), load.latencies.end());
+        result.failed += load.failed;
+    }
+    std::sort(result.latencies.begin(), result.latencies.end());
+    result.per_second = static_cast<double>(result.latencies.size()) / elapsed;
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto arguments = bench::Arguments(argc, argv);
+        const auto sizes     = arguments.numbers("sizes", { 10, 100, 1000 });
+        const auto threads   = arguments.numbers("threads", { yeelight::ScannerOptions().thread_count });
+
+        std::printf("%8s %8s %14s %12s %10s %10s %8s\n", "bulbs", "threads", "discovery ms", "commands/s", "p50 us",
+                    "p99 us", "failed");
+        for(const auto size : sizes)
+        {
+            for(const auto thread_count : threads)
+            {
+                const auto result    = run(arguments, size, thread_count);
+                const auto discovery = std::chrono::duration<double, std::milli>(result.discovery).count();
+
+                if(not result.found)
+                {
+                    std::printf("%8zu %8zu %14s\n", result.bulbs, result.threads, "not all found");
+                    continue;
+                }
+
+                std::printf("%8zu %8zu %14.1f %12.0f %10lld %10lld %8llu\n", result.bulbs, result.threads, discovery,
+                            result.per_second, static_cast<long long>(percentile(result.latencies, 0.5)),
+                            static_cast<long long>(percentile(result.latencies, 0.99)),
+                            static_cast<unsigned long long>(result.failed));
+            }
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
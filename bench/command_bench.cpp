@@ -0,0 +1,145 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Builds commands and their frames the way the device does, with make_command
+// and append_frame, and the way it did before, through a json array and dump.
+// Allocations are counted by replacing the global operator new.
+// command_bench --commands 1000000
+
+#include "arguments.h"
+
+#include "yeelight/schema.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <nlohmann/json.h>
+
+namespace
+{
+size_t allocations = 0;
+}
+
+void* operator new(size_t size)
+{
+    allocations++;
+    if(auto result = std::malloc(size == 0 ? 1 : size)) return result;
+    throw std::bad_alloc();
+}
+
+void operator delete(void* pointer) noexcept
+{
+    std::free(pointer);
+}
+
+void operator delete(void* pointer, size_t) noexcept
+{
+    std::free(pointer);
+}
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+// the command as it was, with an owned method name
+struct OldCommand
+{
+    std::string method;
+    std::string params;
+
+    yeelight::ResponseCallback callback;
+};
+
+template <typename... Args>
+OldCommand make_old_command(std::string method, Args... args)
+{
+    auto params = nlohmann::json::array();
+    (params.emplace_back(std::move(args)), ...);
+
+    return OldCommand{ std::move(method), params.dump(), nullptr };
+}
+
+// every command became a frame of its own in the outbox
+std::string old_frame(uint64_t id, const OldCommand& command)
+{
+    std::string frame;
+    frame.reserve(command.method.size() + command.params.size() + 48);
+
+    frame += "{\"id\":";
+    frame += std::to_string(id);
+    frame += ",\"method\":\"";
+    frame += command.method;
+    frame += "\",\"params\":";
+    frame += command.params;
+    frame += "}\r\n";
+    return frame;
+}
+
+// the sizes keep the optimizer from dropping the work
+template <typename Function>
+void measure(const char* name, size_t commands, Function function)
+{
+    size_t     bytes = 0;
+    const auto start = clock::now();
+    const auto first = allocations;
+    for(size_t i = 0; i < commands; i++) bytes += function(i);
+    const auto count   = allocations - first;
+    const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    const auto per_command = static_cast<double>(commands);
+    std::printf("%-28s %12.1f %16.2f %14zu\n", name, seconds * 1e9 / per_command, static_cast<double>(count) / per_command, bytes);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto arguments = bench::Arguments(argc, argv);
+        const auto commands  = static_cast<size_t>(arguments.number("commands", 1000000));
+
+        // the outbox keeps its capacity between writes, like in the device
+        std::string outbox;
+
+        std::printf("%-28s %12s %16s %14s\n", "path", "ns/command", "allocs/command", "bytes");
+        measure("set_bright json", commands, [](size_t i) {
+            const auto command = make_old_command("set_bright", 1 + i % 100, "smooth", 300);
+            return old_frame(i, command).size();
+        });
+        measure("set_bright make_command", commands, [&](size_t i) {
+            const auto command = make_command(yeelight::method::set_bright, nullptr, 1 + i % 100, "smooth", 300);
+            outbox.clear();
+            yeelight::append_frame(outbox, i, command);
+            return outbox.size();
+        });
+        measure("set_hsv json", commands, [](size_t i) {
+            const auto command = make_old_command("set_hsv", i % 360, 100, "smooth", 300);
+            return old_frame(i, command).size();
+        });
+        measure("set_hsv make_command", commands, [&](size_t i) {
+            const auto command = make_command(yeelight::method::set_hsv, nullptr, i % 360, 100, "smooth", 300);
+            outbox.clear();
+            yeelight::append_frame(outbox, i, command);
+            return outbox.size();
+        });
+        measure("toggle json", commands, [](size_t i) { return old_frame(i, make_old_command("toggle")).size(); });
+        measure("toggle make_command", commands, [&](size_t i) {
+            const auto command = make_command(yeelight::method::toggle, nullptr);
+            outbox.clear();
+            yeelight::append_frame(outbox, i, command);
+            return outbox.size();
+        });
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,42 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Runs a simulated fleet until it is interrupted, to point the app at.
+// fake_bulbs --bulbs 1000 --latency-us 20000 --loss 0.01 --fragment 16
+
+#include "arguments.h"
+#include "fleet.h"
+
+#include <csignal>
+#include <iostream>
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto options = bench::Arguments(argc, argv).fleet();
+        auto       fleet   = bench::FakeFleet(options);
+
+        std::cout << options.bulbs << " bulbs from " << options.first_ip << " on port " << options.tcp_port
+                  << ", searches on " << options.ssdp_ip << ':' << options.ssdp_port << std::endl;
+
+        boost::asio::io_context context;
+        boost::asio::signal_set signals(context, SIGINT, SIGTERM);
+        signals.async_wait([](auto, auto) {});
+        context.run();
+
+        const auto stats = fleet.stats();
+        std::cout << stats.searches << " searches, " << stats.connections << " connections, " << stats.commands
+                  << " commands, " << stats.answered << " answered, " << stats.lost << " lost, " << stats.notifications
+                  << " notifications\n";
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
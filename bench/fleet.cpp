@@ -0,0 +1,431 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "fleet.h"
+
+#include <algorithm>
+#include <iomanip>
+#include <nlohmann/json.h>
+#include <sstream>
+
+namespace
+{
+constexpr auto support = "get_prop set_default set_power toggle set_bright start_cf stop_cf set_scene cron_add cron_get "
+                         "cron_del set_ct_abx set_rgb set_hsv set_adjust set_music set_name";
+
+std::string frame(const nlohmann::json& json)
+{
+    return json.dump() + "\r\n";
+}
+
+} // namespace
+
+namespace bench
+{
+
+FakeFleet::FakeFleet(FleetOptions options)
+: options(std::move(options)), context(), search_socket(context), acceptor(context), bulbs(this->options.bulbs),
+  first_address(boost::asio::ip::make_address_v4(this->options.first_ip).to_uint()), search_sender(),
+  search_buffer(), random(std::random_device()())
+{
+    for(size_t i = 0; i < bulbs.size(); i++)
+    {
+        bulbs[i].id      = 0x10000000 + i;
+        bulbs[i].address = boost::asio::ip::address_v4(first_address + static_cast<uint32_t>(i));
+        bulbs[i].name    = "bulb_" + std::to_string(i);
+    }
+
+    // the scanner listens for announcements on the same port, so both have to allow sharing it
+    const auto ssdp  = boost::asio::ip::make_address_v4(this->options.ssdp_ip);
+    const auto local = ssdp.is_multicast() ? boost::asio::ip::address_v4::any() : ssdp;
+
+    search_socket.open(boost::asio::ip::udp::v4());
+    search_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
+    search_socket.bind(boost::asio::ip::udp::endpoint(local, this->options.ssdp_port));
+    if(ssdp.is_multicast()) search_socket.set_option(boost::asio::ip::multicast::join_group(ssdp));
+
+    // one acceptor for every bulb, the address that was connected to tells which one it is
+    const auto endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), this->options.tcp_port);
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen(boost::asio::socket_base::max_listen_connections);
+
+    start_search_receive();
+    start_accept();
+
+    thread = std::thread([this]() { context.run(); });
+}
+
+FakeFleet::~FakeFleet()
+{
+    context.stop();
+    thread.join();
+}
+
+FleetStats FakeFleet::stats() const
+{
+    FleetStats result;
+    result.searches      = searches;
+    result.connections   = connections;
+    result.commands      = commands;
+    result.answered      = answered;
+    result.lost          = lost;
+    result.notifications = notifications;
+    return result;
+}
+
+void FakeFleet::start_search_receive()
+{
+    const auto handler = [this](auto error, auto bytes) {
+        if(error == boost::asio::error::operation_aborted) return;
+
+        const auto packet = std::string_view(search_buffer.data(), bytes);
+        if(not error and packet.substr(0, 8) == "M-SEARCH" and packet.find("wifi_bulb") != std::string_view::npos)
+        {
+            answer_search(search_sender);
+        }
+        start_search_receive();
+    };
+
+    search_socket.async_receive_from(boost::asio::buffer(search_buffer), search_sender, handler);
+}
+
+void FakeFleet::answer_search(boost::asio::ip::udp::endpoint searcher)
+{
+    searches++;
+
+    auto search      = std::make_shared<Search>(context);
+    search->searcher = searcher;
+
+    const auto now    = std::chrono::steady_clock::now();
+    const auto window = std::chrono::duration_cast<std::chrono::microseconds>(options.answer_window).count();
+    auto       moment = std::uniform_int_distribution<int64_t>(0, std::max<int64_t>(window, 0));
+
+    search->order.reserve(bulbs.size());
+    for(size_t i = 0; i < bulbs.size(); i++) search->order.emplace_back(now + std::chrono::microseconds(moment(random)), i);
+    std::sort(search->order.begin(), search->order.end());
+
+    answer_next(search);
+}
+
+void FakeFleet::answer_next(const std::shared_ptr<Search>& search)
+{
+    const auto now   = std::chrono::steady_clock::now();
+    auto&      order = search->order;
+
+    for(; search->next < order.size() and order[search->next].first <= now; search->next++)
+    {
+        // a full receive buffer on the other side loses the answer, like a busy network would
+        const auto                answer = search_answer(bulbs[order[search->next].second]);
+        boost::system::error_code ignored;
+        search_socket.send_to(boost::asio::buffer(answer), search->searcher, 0, ignored);
+    }
+    if(search->next == order.size()) return;
+
+    search->timer.expires_at(order[search->next].first);
+    search->timer.async_wait([this, search](auto error) {
+        if(not error) answer_next(search);
+    });
+}
+
+std::string FakeFleet::search_answer(const Bulb& bulb) const
+{
+    std::ostringstream stream;
+    stream << "HTTP/1.1 200 OK\r\n"
+           << "Cache-Control: max-age=3600\r\n"
+           << "Location: yeelight://" << bulb.address.to_string() << ':' << options.tcp_port << "\r\n"
+           << "Server: POSIX UPnP/1.0 YGLC/1\r\n"
+           << "id: 0x" << std::hex << std::setw(16) << std::setfill('0') << bulb.id << std::dec << "\r\n"
+           << "model: color\r\n"
+           << "fw_ver: 18\r\n"
+           << "support: " << support << "\r\n"
+           << "power: " << (bulb.power ? "on" : "off") << "\r\n"
+           << "bright: " << bulb.bright << "\r\n"
+           << "color_mode: " << bulb.mode << "\r\n"
+           << "ct: " << bulb.ct << "\r\n"
+           << "rgb: " << bulb.rgb << "\r\n"
+           << "hue: " << bulb.hue << "\r\n"
+           << "sat: " << bulb.sat << "\r\n"
+           << "name: " << bulb.name << "\r\n";
+    return stream.str();
+}
+
+void FakeFleet::start_accept()
+{
+    auto session = std::make_shared<Session>(context, 0);
+
+    const auto handler = [this, session](auto error) {
+        if(error == boost::asio::error::operation_aborted) return;
+
+        boost::system::error_code ignored;
+        const auto                local = session->socket.local_endpoint(ignored).address();
+        const auto                index = local.is_v4() ? local.to_v4().to_uint() - first_address : bulbs.size();
+
+        if(not error and index < bulbs.size())
+        {
+            session->bulb = index;
+            session->socket.set_option(boost::asio::ip::tcp::no_delay(true), ignored);
+
+            auto& sessions = bulbs[index].sessions;
+            sessions.erase(std::remove_if(sessions.begin(), sessions.end(), [](const auto& elem) { return elem.expired(); }),
+                           sessions.end());
+            sessions.push_back(session);
+
+            connections++;
+            start_read(session);
+        }
+        start_accept();
+    };
+
+    acceptor.async_accept(session->socket, handler);
+}
+
+void FakeFleet::start_read(const std::shared_ptr<Session>& session)
+{
+    const auto handler = [this, session](auto error, auto bytes) {
+        if(error)
+        {
+            close(session);
+            return;
+        }
+
+        session->reader.commit(bytes);
+        while(const auto line = session->reader.next()) handle_command(session, *line);
+
+        start_read(session);
+    };
+
+    session->socket.async_read_some(session->reader.prepare(), handler);
+}
+
+void FakeFleet::close(const std::shared_ptr<Session>& session)
+{
+    boost::system::error_code ignored;
+    session->timer.cancel(ignored);
+    session->socket.close(ignored);
+
+    auto& bulb = bulbs[session->bulb];
+    if(bulb.music == session) bulb.music = nullptr;
+}
+
+void FakeFleet::handle_command(const std::shared_ptr<Session>& session, std::string_view line)
+{
+    commands++;
+
+    const auto json = nlohmann::json::parse(line.begin(), line.end(), nullptr, false);
+    if(json.is_discarded() or not json.is_object()) return;
+
+    const auto id     = json.find("id");
+    const auto method = json.find("method");
+    const auto params = json.find("params");
+    if(id == json.end() or not id->is_number_unsigned() or method == json.end() or not method->is_string()) return;
+
+    const auto empty     = nlohmann::json::array();
+    const auto arguments = params != json.end() and params->is_array() ? *params : empty;
+
+    if(not session->music and options.loss > 0 and std::uniform_real_distribution<double>()(random) < options.loss)
+    {
+        lost++;
+        return;
+    }
+
+    const auto number = [&](size_t index) {
+        return index < arguments.size() and arguments[index].is_number_unsigned() ? arguments[index].get<uint32_t>() : 0;
+    };
+    const auto text = [&](size_t index) {
+        return index < arguments.size() and arguments[index].is_string() ? arguments[index].get<std::string>() : std::string();
+    };
+
+    auto&      bulb    = bulbs[session->bulb];
+    const auto name    = method->get<std::string>();
+    auto       result  = nlohmann::json::array({ "ok" });
+    auto       changed = nlohmann::json::object(); // the bulb sends every value as a string
+
+    if(name == "get_prop")
+    {
+        result = nlohmann::json::array();
+        for(size_t i = 0; i < arguments.size(); i++)
+        {
+            const auto property = text(i);
+            if(property == "power") result.push_back(bulb.power ? "on" : "off");
+            else if(property == "bright") result.push_back(std::to_string(bulb.bright));
+            else if(property == "color_mode") result.push_back(std::to_string(bulb.mode));
+            else if(property == "ct") result.push_back(std::to_string(bulb.ct));
+            else if(property == "rgb") result.push_back(std::to_string(bulb.rgb));
+            else if(property == "hue") result.push_back(std::to_string(bulb.hue));
+            else if(property == "sat") result.push_back(std::to_string(bulb.sat));
+            else if(property == "flowing") result.push_back(bulb.flowing ? "1" : "0");
+            else if(property == "name") result.push_back(bulb.name);
+            else result.push_back("");
+        }
+    }
+    else if(name == "set_power" or name == "toggle")
+    {
+        bulb.power       = name == "toggle" ? not bulb.power : text(0) == "on";
+        changed["power"] = bulb.power ? "on" : "off";
+    }
+    else if(name == "set_bright")
+    {
+        bulb.bright       = std::clamp<uint32_t>(number(0), 1, 100);
+        changed["bright"] = std::to_string(bulb.bright);
+    }
+    else if(name == "set_rgb" or name == "set_ct_abx" or name == "set_hsv")
+    {
+        if(name == "set_rgb") bulb.rgb = number(0) & 0xFFFFFF;
+        if(name == "set_ct_abx") bulb.ct = std::clamp<uint32_t>(number(0), 1700, 6500);
+        if(name == "set_hsv") bulb.hue = std::min<uint32_t>(number(0), 359);
+        if(name == "set_hsv") bulb.sat = std::min<uint32_t>(number(1), 100);
+
+        bulb.mode             = name == "set_rgb" ? 1 : name == "set_ct_abx" ? 2 : 3;
+        changed["color_mode"] = std::to_string(bulb.mode);
+        changed["rgb"]        = std::to_string(bulb.rgb);
+        changed["ct"]         = std::to_string(bulb.ct);
+        changed["hue"]        = std::to_string(bulb.hue);
+        changed["sat"]        = std::to_string(bulb.sat);
+    }
+    else if(name == "start_cf" or name == "stop_cf")
+    {
+        bulb.flowing       = name == "start_cf";
+        changed["flowing"] = bulb.flowing ? "1" : "0";
+    }
+    else if(name == "set_name")
+    {
+        bulb.name       = text(0);
+        changed["name"] = bulb.name;
+    }
+    else if(name == "set_music")
+    {
+        boost::system::error_code error;
+        const auto                address = boost::asio::ip::make_address_v4(text(1), error);
+
+        if(number(0) == 1 and not error) start_music(session->bulb, boost::asio::ip::tcp::endpoint(address, number(2)));
+        else if(bulb.music != nullptr) close(bulb.music);
+    }
+    else if(name != "cron_add" and name != "cron_del")
+    {
+        result = nullptr;
+    }
+
+    // the bulb does not answer anything that comes in over the music connection
+    if(not session->music)
+    {
+        auto answer     = nlohmann::json::object();
+        answer["id"]    = *id;
+        if(result.is_null()) answer["error"] = { { "code", -1 }, { "message", "method not supported" } };
+        else answer["result"] = result;
+
+        send(session, frame(answer), true);
+        answered++;
+    }
+
+    if(not changed.empty()) notify(session, frame({ { "method", "props" }, { "params", changed } }));
+}
+
+void FakeFleet::start_music(size_t bulb, boost::asio::ip::tcp::endpoint server)
+{
+    auto& music = bulbs[bulb].music;
+    if(music != nullptr) close(music);
+
+    music        = std::make_shared<Session>(context, bulb);
+    music->music = true;
+
+    // the music server knows the bulb by the address it connects from
+    boost::system::error_code error;
+    music->socket.open(boost::asio::ip::tcp::v4(), error);
+    if(not error) music->socket.bind(boost::asio::ip::tcp::endpoint(bulbs[bulb].address, 0), error);
+    if(error)
+    {
+        music = nullptr;
+        return;
+    }
+
+    music->socket.async_connect(server, [this, session = music](auto error) {
+        if(error) close(session);
+        else start_read(session);
+    });
+}
+
+void FakeFleet::send(const std::shared_ptr<Session>& session, std::string text, bool delayed)
+{
+    auto due = std::chrono::steady_clock::now();
+    if(delayed) due += latency();
+
+    // the bulb answers in order, a quick answer waits behind a slow one
+    auto& answers = session->answers;
+    if(not answers.empty()) due = std::max(due, answers.back().first);
+    answers.emplace_back(due, std::move(text));
+
+    // the timer is already going for an earlier answer otherwise
+    if(answers.size() != 1) return;
+
+    session->timer.expires_at(due);
+    session->timer.async_wait([this, session](auto error) {
+        if(not error) flush(session);
+    });
+}
+
+void FakeFleet::flush(const std::shared_ptr<Session>& session)
+{
+    const auto now     = std::chrono::steady_clock::now();
+    auto&      answers = session->answers;
+
+    // everything that is due goes out together, so answers share segments like they do on a real bulb
+    const auto busy   = not session->writing.empty();
+    auto&      output = busy ? session->waiting : session->writing;
+    for(; not answers.empty() and answers.front().first <= now; answers.pop_front()) output += answers.front().second;
+
+    if(not busy and not output.empty()) start_write(session);
+    if(answers.empty()) return;
+
+    session->timer.expires_at(answers.front().first);
+    session->timer.async_wait([this, session](auto error) {
+        if(not error) flush(session);
+    });
+}
+
+void FakeFleet::start_write(const std::shared_ptr<Session>& session)
+{
+    const auto rest = session->writing.size() - session->written;
+    const auto size = options.fragment == 0 ? rest : std::min(rest, options.fragment);
+
+    const auto handler = [this, session](auto error, auto bytes) {
+        if(error) return; // the read notices the connection is gone
+
+        session->written += bytes;
+        if(session->written == session->writing.size())
+        {
+            session->writing.clear();
+            session->written = 0;
+            std::swap(session->writing, session->waiting);
+            if(session->writing.empty()) return;
+        }
+        start_write(session);
+    };
+
+    boost::asio::async_write(session->socket, boost::asio::buffer(session->writing.data() + session->written, size), handler);
+}
+
+void FakeFleet::notify(const std::shared_ptr<Session>& session, const std::string& params)
+{
+    for(const auto& weak : bulbs[session->bulb].sessions)
+    {
+        const auto other = weak.lock();
+        if(other == nullptr or not other->socket.is_open()) continue;
+
+        // the one that sent the command hears about it after the answer
+        send(other, params, other == session);
+        notifications++;
+    }
+}
+
+std::chrono::steady_clock::duration FakeFleet::latency()
+{
+    const auto jitter = std::uniform_int_distribution<int64_t>(0, std::max<int64_t>(options.jitter.count(), 0))(random);
+    return options.latency + std::chrono::microseconds(jitter);
+}
+
+} // namespace bench
@@ -0,0 +1,193 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "yeelight/reader.h"
+
+namespace bench
+{
+
+using namespace std::chrono_literals;
+
+struct FleetOptions
+{
+    size_t bulbs = 100;
+
+    // where searches are answered, a multicast address is joined and a unicast one is bound,
+    // so it can share the port with a scanner on the same host
+    std::string ssdp_ip   = "127.0.0.1";
+    uint16_t    ssdp_port = 1982;
+
+    // every bulb has an address of its own counting up from this one, they all take tcp on the same port
+    std::string first_ip = "127.0.1.1";
+    uint16_t    tcp_port = 55443;
+
+    // a command is answered after latency plus up to jitter, in the order they came in
+    std::chrono::microseconds latency = 2ms;
+    std::chrono::microseconds jitter  = 1ms;
+
+    // the part of the commands that is never answered, nor carried out
+    double loss = 0;
+
+    // answers are written in pieces of at most this many bytes, zero writes them whole
+    size_t fragment = 0;
+
+    // the bulbs answer a search at random moments within this long, like real ones do
+    std::chrono::milliseconds answer_window = 100ms;
+};
+
+struct FleetStats
+{
+    uint64_t searches      = 0;
+    uint64_t connections   = 0;
+    uint64_t commands      = 0;
+    uint64_t answered      = 0;
+    uint64_t lost          = 0;
+    uint64_t notifications = 0;
+};
+
+// Thousands of simulated bulbs on loopback. They answer M-SEARCH, take
+// commands over tcp and push props notifications on every change, like the
+// real ones. A bulb in music mode connects back to the music server and takes
+// commands without answering them.
+// Everything runs on a single thread of its own, the stats can be read from anywhere.
+class FakeFleet
+{
+    public:
+    // throws boost::system::system_error when the ports are taken
+    explicit FakeFleet(FleetOptions options = FleetOptions());
+
+    ~FakeFleet();
+
+    FakeFleet(const FakeFleet&) = delete;
+
+    FakeFleet operator=(const FakeFleet&) = delete;
+
+    [[nodiscard]] FleetStats stats() const;
+
+    private:
+    struct Session;
+
+    struct Bulb
+    {
+        uint64_t                    id;
+        boost::asio::ip::address_v4 address;
+
+        bool        power   = true;
+        uint32_t    bright  = 100;
+        uint32_t    mode    = 2;
+        uint32_t    ct      = 4000;
+        uint32_t    rgb     = 0xFFFFFF;
+        uint32_t    hue     = 0;
+        uint32_t    sat     = 0;
+        bool        flowing = false;
+        std::string name;
+
+        // the control connections, which get the notifications, and the one of music mode
+        std::vector<std::weak_ptr<Session>> sessions;
+        std::shared_ptr<Session>            music;
+    };
+
+    struct Session
+    {
+        Session(boost::asio::io_context& context, size_t bulb) : socket(context), timer(context), bulb(bulb) {}
+
+        boost::asio::ip::tcp::socket socket;
+        boost::asio::steady_timer    timer;
+        size_t                       bulb;
+        bool                         music = false; // takes commands without answering
+
+        yeelight::LineReader reader;
+
+        // what still has to be written and when, in the order the commands came in
+        std::deque<std::pair<std::chrono::steady_clock::time_point, std::string>> answers;
+
+        std::string writing; // being written, in fragments
+        size_t      written = 0;
+        std::string waiting; // became due while a write was busy
+    };
+
+    // the answers to one search, every bulb at its own moment
+    struct Search
+    {
+        explicit Search(boost::asio::io_context& context) : timer(context) {}
+
+        boost::asio::ip::udp::endpoint                                        searcher;
+        std::vector<std::pair<std::chrono::steady_clock::time_point, size_t>> order; // sorted on time
+        size_t                                                                next = 0;
+        boost::asio::steady_timer                                             timer;
+    };
+
+    void start_search_receive();
+
+    void answer_search(boost::asio::ip::udp::endpoint searcher);
+
+    void answer_next(const std::shared_ptr<Search>& search);
+
+    [[nodiscard]] std::string search_answer(const Bulb& bulb) const;
+
+    void start_accept();
+
+    void start_read(const std::shared_ptr<Session>& session);
+
+    void close(const std::shared_ptr<Session>& session);
+
+    void handle_command(const std::shared_ptr<Session>& session, std::string_view line);
+
+    void start_music(size_t bulb, boost::asio::ip::tcp::endpoint server);
+
+    // queues the text behind the earlier answers of the session, after the simulated latency
+    void send(const std::shared_ptr<Session>& session, std::string text, bool delayed);
+
+    void flush(const std::shared_ptr<Session>& session);
+
+    void start_write(const std::shared_ptr<Session>& session);
+
+    // pushes a props notification to every control connection of the bulb
+    void notify(const std::shared_ptr<Session>& session, const std::string& params);
+
+    // the simulated time a bulb takes to carry out a command
+    [[nodiscard]] std::chrono::steady_clock::duration latency();
+
+    FleetOptions options;
+
+    boost::asio::io_context        context;
+    boost::asio::ip::udp::socket   search_socket;
+    boost::asio::ip::tcp::acceptor acceptor;
+
+    std::vector<Bulb> bulbs;
+    uint32_t          first_address;
+
+    boost::asio::ip::udp::endpoint search_sender;
+    std::array<char, 1024>         search_buffer;
+
+    std::mt19937 random;
+
+    std::atomic<uint64_t> searches      = 0;
+    std::atomic<uint64_t> connections   = 0;
+    std::atomic<uint64_t> commands      = 0;
+    std::atomic<uint64_t> answered      = 0;
+    std::atomic<uint64_t> lost          = 0;
+    std::atomic<uint64_t> notifications = 0;
+
+    std::thread thread;
+};
+
+} // namespace bench
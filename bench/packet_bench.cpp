@@ -0,0 +1,140 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Times the icmp path of the pinger against how it was done before: the
+// checksum of a request, and decoding an echo reply with Ipv4View and
+// IcmpView instead of istringstream >> ipv4_header >> icmp_header.
+// packet_bench --rounds 1000000
+
+#include "arguments.h"
+
+#include "yeelight/packet.h"
+
+#include <boost-icmp/icmp_header.hpp>
+#include <boost-icmp/ipv4_header.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+// the checksum as the pinger computed it before, two bytes at a time
+uint16_t checksum(const unsigned char* data, size_t size)
+{
+    uint32_t sum = 0;
+    for(size_t i = 0; i + 1 < size; i += 2) sum += (data[i] << 8) + data[i + 1];
+    if(size % 2 == 1) sum += data[size - 1] << 8;
+
+    sum = (sum >> 16) + (sum & 0xFFFF);
+    sum += (sum >> 16);
+    return static_cast<uint16_t>(~sum);
+}
+
+void encode(unsigned char* data, uint16_t value)
+{
+    data[0] = static_cast<unsigned char>(value >> 8);
+    data[1] = static_cast<unsigned char>(value & 0xFF);
+}
+
+// an echo reply to the pinger, as the raw socket hands it over: ip header, icmp header, body
+std::vector<unsigned char> make_reply()
+{
+    const unsigned char body[] = { 'y', 'e', 'e', 'l', 'i' };
+
+    std::vector<unsigned char> packet(20 + 8 + sizeof(body), 0);
+    packet[0] = 0x45;
+    encode(packet.data() + 2, static_cast<uint16_t>(packet.size()));
+    packet[8] = 64;
+    packet[9] = 1;
+    packet[12] = 192;
+    packet[13] = 168;
+    packet[14] = 1;
+    packet[15] = 239;
+
+    auto icmp = packet.data() + 20;
+    icmp[0]   = icmp_header::echo_reply;
+    encode(icmp + 4, 0x1234);
+    encode(icmp + 6, 42);
+    std::copy(std::begin(body), std::end(body), icmp + 8);
+    encode(icmp + 2, checksum(icmp, 8 + sizeof(body)));
+    return packet;
+}
+
+uint64_t parse_stream(const std::vector<unsigned char>& packet)
+{
+    ipv4_header        ipv4;
+    icmp_header        icmp;
+    std::istringstream stream(std::string(packet.begin(), packet.end()));
+    if(not(stream >> ipv4 >> icmp)) return 0;
+    if(icmp.type() != icmp_header::echo_reply) return 0;
+
+    return icmp.identifier() ^ icmp.sequence_number() ^ ipv4.source_address().to_uint();
+}
+
+uint64_t parse_view(const std::vector<unsigned char>& packet)
+{
+    const auto ipv4 = yeelight::Ipv4View::parse(packet.data(), packet.size());
+    if(not ipv4 or ipv4->protocol() != 1) return 0;
+
+    const auto icmp = yeelight::IcmpView::parse(ipv4->payload(), ipv4->payload_size());
+    if(not icmp or icmp->type() != icmp_header::echo_reply) return 0;
+
+    return icmp->identifier() ^ icmp->sequence_number() ^ ipv4->source_address().to_uint();
+}
+
+// the checksum keeps the optimizer from dropping the work, the round from hoisting it out of the loop
+template<typename Function>
+void measure(const char* name, size_t rounds, Function function)
+{
+    uint64_t   checksum = 0;
+    const auto start    = clock::now();
+    for(size_t i = 0; i < rounds; i++) checksum += function(i);
+    const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    const auto per_second = static_cast<double>(rounds) / seconds;
+    std::printf("%-34s %14.0f %10.1f %20llu\n", name, per_second, 1e9 / per_second, static_cast<unsigned long long>(checksum));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto arguments = bench::Arguments(argc, argv);
+        const auto rounds    = static_cast<size_t>(arguments.number("rounds", 1000000));
+
+        const auto reply   = make_reply();
+        auto       request = std::vector<unsigned char>(reply.begin() + 20, reply.end());
+        auto       large   = std::vector<unsigned char>(1480, 0xA5);
+
+        // a different sequence number every round, like the pinger itself
+        const auto sum = [](auto function, std::vector<unsigned char>& data) {
+            return [function, &data](size_t round) {
+                data[6] = static_cast<unsigned char>(round);
+                return function(data.data(), data.size());
+            };
+        };
+
+        std::printf("%-34s %14s %10s %20s\n", "operation", "per second", "ns", "checksum");
+        measure("checksum 13 bytes, before", rounds, sum(checksum, request));
+        measure("ones_complement_sum 13 bytes", rounds, sum(yeelight::ones_complement_sum, request));
+        measure("checksum 1480 bytes, before", rounds, sum(checksum, large));
+        measure("ones_complement_sum 1480 bytes", rounds, sum(yeelight::ones_complement_sum, large));
+        measure("istringstream >> headers", rounds, [&](size_t) { return parse_stream(reply); });
+        measure("Ipv4View and IcmpView", rounds, [&](size_t) { return parse_view(reply); });
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
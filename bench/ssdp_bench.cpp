@@ -0,0 +1,118 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Parses the same discovery response over and over, with parse_advertisement
+// and with the map of strings the scanner used before it, in packets/s.
+// ssdp_bench --packets 1000000
+
+#include "arguments.h"
+
+#include "yeelight/ssdp.h"
+
+#include <boost/asio/ip/address.hpp>
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+const std::string response = "HTTP/1.1 200 OK\r\n"
+                             "Cache-Control: max-age=3600\r\n"
+                             "Date: \r\n"
+                             "Ext: \r\n"
+                             "Location: yeelight://192.168.1.239:55443\r\n"
+                             "Server: POSIX UPnP/1.0 YGLC/1\r\n"
+                             "id: 0x000000000015243f\r\n"
+                             "model: color\r\n"
+                             "fw_ver: 18\r\n"
+                             "support: get_prop set_default set_power toggle set_bright start_cf stop_cf set_scene "
+                             "cron_add cron_get cron_del set_ct_abx set_rgb\r\n"
+                             "power: on\r\n"
+                             "bright: 100\r\n"
+                             "color_mode: 2\r\n"
+                             "ct: 4000\r\n"
+                             "rgb: 16711680\r\n"
+                             "hue: 100\r\n"
+                             "sat: 35\r\n"
+                             "name: my_bulb\r\n";
+
+// the parser as it was in the scanner, only the id and endpoint came out of it
+uint64_t parse_map(std::string_view packet)
+{
+    const static std::string http_ok = "HTTP/1.1 200 OK\r\n";
+
+    auto iter = packet.begin();
+    if(not std::equal(http_ok.begin(), http_ok.end(), packet.begin())) return 0;
+    iter += http_ok.size();
+
+    std::map<std::string, std::string> data;
+    while(true)
+    {
+        const auto key_end     = std::find(iter, packet.end(), ':');
+        const auto value_start = key_end + 2;
+        if(value_start >= packet.end()) return 0;
+
+        const auto value_end = std::find(value_start, packet.end(), '\r');
+        data.emplace(std::string(iter, key_end), std::string(value_start, value_end));
+
+        if(value_end + 2 >= packet.end()) break;
+        iter = value_end + 2;
+    }
+
+    const auto index = data["Location"].find_first_of(':', 11);
+    if(index == std::string::npos) return 0;
+
+    const auto id      = std::stoul(data["id"], nullptr, 16);
+    const auto address = boost::asio::ip::make_address(data["Location"].substr(11, index - 11));
+    const auto port    = std::stoul(data["Location"].substr(index + 1));
+    return id ^ address.to_v4().to_uint() ^ port;
+}
+
+uint64_t parse_view(std::string_view packet)
+{
+    const auto advertisement = yeelight::parse_advertisement(packet);
+    if(not advertisement) return 0;
+    return advertisement->id ^ advertisement->address.to_uint() ^ advertisement->port;
+}
+
+// the checksum keeps the optimizer from dropping the work
+template<typename Parse>
+void measure(const char* name, size_t packets, Parse parse)
+{
+    uint64_t   checksum = 0;
+    const auto start    = clock::now();
+    for(size_t i = 0; i < packets; i++) checksum += parse(response);
+    const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    const auto per_second = static_cast<double>(packets) / seconds;
+    std::printf("%-22s %14.0f %10.1f %20llu\n", name, per_second, 1e9 / per_second, static_cast<unsigned long long>(checksum));
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto arguments = bench::Arguments(argc, argv);
+        const auto packets   = static_cast<size_t>(arguments.number("packets", 1000000));
+
+        std::printf("%-22s %14s %10s %20s\n", "parser", "packets/s", "ns/packet", "checksum");
+        measure("map of strings", packets, parse_map);
+        measure("parse_advertisement", packets, parse_view);
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
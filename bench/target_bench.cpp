@@ -0,0 +1,114 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Builds the GetPlayerSummaries target for 100 and 10000 steam ids with
+// target_builder, and with the += and to_string builder and boost::join it
+// replaced.
+// target_bench --rounds 1000 --sizes 100,10000
+
+#include "arguments.h"
+
+#include "http/helper.h"
+
+#include <boost/algorithm/string/join.hpp>
+#include <boost/range/adaptor/transformed.hpp>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+
+namespace
+{
+using clock = std::chrono::steady_clock;
+
+// the builder as it was, nothing was encoded
+class old_target_builder
+{
+    public:
+    explicit old_target_builder(std::string path) : result(std::move(path)) {}
+
+    template <typename Type>
+    old_target_builder& operator()(const std::string& key, const Type& value)
+    {
+        if(not first) result += '&';
+        else
+            result += '?';
+        first = false;
+
+        result += key;
+        result += '=';
+
+        if constexpr(std::is_same_v<std::decay_t<Type>, char*> or std::is_same_v<Type, std::string>)
+            result += value;
+        else
+            result += std::to_string(value);
+
+        return *this;
+    }
+
+    [[nodiscard]] std::string string() const { return result; }
+
+    private:
+    bool        first = true;
+    std::string result;
+};
+
+size_t build_old(const std::string& key, const std::vector<uint64_t>& steam_ids)
+{
+    const auto         func = static_cast<std::string (*)(uint64_t)>(std::to_string);
+    old_target_builder builder("/ISteamUser/GetPlayerSummaries/v0002/");
+    builder("key", key)("steamids", boost::join(steam_ids | boost::adaptors::transformed(func), ","));
+    return builder.string().size();
+}
+
+size_t build_new(const std::string& key, const std::vector<uint64_t>& steam_ids)
+{
+    target_builder builder("/ISteamUser/GetPlayerSummaries/v0002/", 64 + key.size() * 3 + steam_ids.size() * 21);
+    builder("key", key)("steamids", steam_ids);
+    return builder.string().size();
+}
+
+// the sizes keep the optimizer from dropping the work
+template <typename Build>
+void measure(const char* name, size_t rounds, const std::string& key, const std::vector<uint64_t>& steam_ids, Build build)
+{
+    size_t     bytes = 0;
+    const auto start = clock::now();
+    for(size_t i = 0; i < rounds; i++) bytes += build(key, steam_ids);
+    const auto seconds = std::chrono::duration<double>(clock::now() - start).count();
+
+    std::printf("%-16s %8zu %14.2f %14zu\n", name, steam_ids.size(), seconds * 1e6 / static_cast<double>(rounds), bytes);
+}
+
+} // namespace
+
+int main(int argc, char** argv)
+{
+    try
+    {
+        const auto arguments = bench::Arguments(argc, argv);
+        const auto rounds    = static_cast<size_t>(arguments.number("rounds", 1000));
+        const auto sizes     = arguments.numbers("sizes", { 100, 10000 });
+
+        // an api key is 32 hexadecimal characters, steam ids are 17 digits
+        const auto key = std::string("0123456789ABCDEF0123456789ABCDEF");
+
+        std::printf("%-16s %8s %14s %14s\n", "builder", "ids", "us/target", "bytes");
+        for(const auto size : sizes)
+        {
+            std::vector<uint64_t> steam_ids(size);
+            for(size_t i = 0; i < size; i++) steam_ids[i] = 76561197960265728ull + i * 7919;
+
+            measure("+= and to_string", rounds, key, steam_ids, build_old);
+            measure("target_builder", rounds, key, steam_ids, build_new);
+        }
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+    return 0;
+}
@@ -8,6 +8,9 @@
 #pragma once
 
 #include "../yeelight/device.h"
+#include <QtCore/QMetaObject>
+#include <QtCore/QSignalBlocker>
+#include <QtWidgets/QCheckBox>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QSlider>
 #include <QtWidgets/QVBoxLayout>
@@ -18,35 +21,26 @@ class DeviceWidget : public QWidget
 {
     public:
     explicit DeviceWidget(std::unique_ptr<yeelight::Device> lamp)
-    : device(std::move(lamp)), button(new QPushButton), layout(new QVBoxLayout),
+    : device(std::move(lamp)), button(new QPushButton), music(new QCheckBox("music mode")), layout(new QVBoxLayout),
       brightness(new QSlider(Qt::Horizontal)), red(new QSlider(Qt::Horizontal)),
       green(new QSlider(Qt::Horizontal)), blue(new QSlider(Qt::Horizontal))
     {
-        button->setEnabled(false);
-
-        brightness->setEnabled(false);
+        // everything stays usable while disconnected, a command makes the device connect
         brightness->setRange(1, 100);
-        brightness->setTracking(false);
+        brightness->setTracking(true);
 
-        red->setEnabled(false);
         red->setRange(0, 255);
-        red->setTracking(false);
+        red->setTracking(true);
 
-        green->setEnabled(false);
         green->setRange(0, 255);
-        green->setTracking(false);
+        green->setTracking(true);
 
-        blue->setEnabled(false);
         blue->setRange(0, 255);
-        blue->setTracking(false);
+        blue->setTracking(true);
 
-        const auto update_callback = [this](yeelight::Parameter parameter, yeelight::Value value)
+        const auto update = [](yeelight::Parameter parameter, [[maybe_unused]] yeelight::Value value)
         {
-            if(parameter == yeelight::Parameter::connected)
-            {
-                button->setEnabled(value);
-            }
-            else if(parameter == yeelight::Parameter::powered)
+            if(parameter == yeelight::Parameter::powered)
             {
                 std::cout << "powered changed\n";
             }
@@ -56,9 +50,23 @@ class DeviceWidget : public QWidget
             }
         };
 
+        // the device calls back from its own thread, so queue the update onto ours
+        const auto update_callback = [this, update](yeelight::Parameter parameter, yeelight::Value value) {
+            QMetaObject::invokeMethod(this, std::bind(update, parameter, value), Qt::QueuedConnection);
+        };
+
         device->set_update_callback(update_callback);
 
+        // the scanner already told the device what it is doing, so show that right away
+        show_state(device->current_state());
+
+        const auto state_callback = [this](const yeelight::DeviceState& state) {
+            QMetaObject::invokeMethod(this, std::bind(&DeviceWidget::show_state, this, state), Qt::QueuedConnection);
+        };
+        device->set_state_callback(state_callback);
+
         layout->addWidget(button);
+        layout->addWidget(music);
         layout->addWidget(brightness);
 
         layout->addWidget(red);
@@ -75,16 +83,52 @@ class DeviceWidget : public QWidget
 
         const auto bright = [&](int brightness) { device->set_brightness(brightness); };
 
-        connect(button, &QPushButton::pressed, std::bind(&yeelight::Device::toggle, device.get()));
+        connect(button, &QPushButton::pressed, [this]() { device->toggle(); });
+
+        // the sliders then go out every frame instead of being paced to the bulb's quota
+        const auto music_mode = [this](bool checked) { device->set_music(checked); };
+        connect(music, &QCheckBox::toggled, music_mode);
         connect(brightness, &QSlider::valueChanged, bright);
 
+        // the device queue coalesces and paces these, so dragging is fine
         connect(red, &QSlider::valueChanged, color);
+        connect(green, &QSlider::valueChanged, color);
+        connect(blue, &QSlider::valueChanged, color);
+    }
+
+    protected:
+    void show_state(const yeelight::DeviceState& state)
+    {
+        // these should not be sent back to the device
+        const QSignalBlocker brightness_blocker(brightness);
+        const QSignalBlocker red_blocker(red);
+        const QSignalBlocker green_blocker(green);
+        const QSignalBlocker blue_blocker(blue);
+
+        button->setText(QString::fromStdString(state.name));
+        brightness->setValue(static_cast<int>(state.brightness));
+        red->setValue(static_cast<int>((state.rgb >> 16) & 0xFF));
+        green->setValue(static_cast<int>((state.rgb >> 8) & 0xFF));
+        blue->setValue(static_cast<int>(state.rgb & 0xFF));
+    }
+
+    void showEvent(QShowEvent* event) override
+    {
+        device->set_visible(true);
+        QWidget::showEvent(event);
+    }
+
+    void hideEvent(QHideEvent* event) override
+    {
+        device->set_visible(false);
+        QWidget::hideEvent(event);
     }
 
     private:
     std::unique_ptr<yeelight::Device> device;
 
     QPushButton* button;
+    QCheckBox*   music;
     QVBoxLayout* layout;
     QSlider*     brightness;
 
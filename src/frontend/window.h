@@ -10,6 +10,7 @@
 #include "../yeelight/scanner.h"
 #include "deviceWidget.h"
 
+#include <QtCore/QMetaObject>
 #include <QtWidgets/QColorDialog>
 #include <QtWidgets/QGridLayout>
 #include <QtWidgets/QMainWindow>
@@ -30,7 +31,11 @@ class Window : public QMainWindow
 
     void device_found(std::unique_ptr<yeelight::Device> device)
     {
-        layout->addWidget(new DeviceWidget(std::move(device)));
+        // this is called from a network thread, widgets can only be made on ours
+        const auto add = [this, raw = device.release()]() {
+            layout->addWidget(new DeviceWidget(std::unique_ptr<yeelight::Device>(raw)));
+        };
+        QMetaObject::invokeMethod(this, add, Qt::QueuedConnection);
     }
 
     private:
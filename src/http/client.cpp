@@ -0,0 +1,274 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/24/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "client.h"
+
+#include <algorithm>
+
+namespace
+{
+// requests that do the same when they are sent twice
+bool is_idempotent(http::verb verb)
+{
+    switch(verb)
+    {
+    case http::verb::get:
+    case http::verb::head:
+    case http::verb::put:
+    case http::verb::delete_:
+    case http::verb::options: return true;
+    default: return false;
+    }
+}
+
+} // namespace
+
+http_client::http_client(boost::asio::io_context& context, client_options options)
+: strand(boost::asio::make_strand(context)), resolver(strand), options(options), pools()
+{
+    this->options.max_connections = std::max<size_t>(this->options.max_connections, 1);
+    this->options.max_pipeline    = std::max<size_t>(this->options.max_pipeline, 1);
+}
+
+void http_client::async_request(const std::string& host, const std::string& port, request_type request, callback done)
+{
+    auto entry  = std::make_shared<request_entry>();
+    entry->done = std::move(done);
+
+    entry->request = std::move(request);
+    if(entry->request[http::field::host].empty()) entry->request.set(http::field::host, host);
+    entry->request.keep_alive(true);
+    entry->request.prepare_payload();
+
+    boost::asio::post(strand, [this, host, port, entry]() {
+        auto& pool = pools[host + ':' + port];
+        pool.host  = host;
+        pool.port  = port;
+
+        pool.waiting.emplace_back(entry);
+        pump(pool);
+    });
+}
+
+std::future<http_client::response_type>
+http_client::request(const std::string& host, const std::string& port, request_type request)
+{
+    auto promise = std::make_shared<std::promise<response_type>>();
+    auto result  = promise->get_future();
+
+    async_request(host, port, std::move(request), [promise](auto error, auto response) {
+        if(error) promise->set_exception(std::make_exception_ptr(boost::system::system_error(error)));
+        else promise->set_value(std::move(response));
+    });
+
+    return result;
+}
+
+void http_client::pump(host_pool& pool)
+{
+    while(not pool.waiting.empty())
+    {
+        const auto& entry = pool.waiting.front();
+
+        // an idle connection first, then a new one, only then do we queue behind another request
+        const auto idle = [](const auto& conn) { return conn->connected and conn->in_flight.empty(); };
+        const auto iter = std::find_if(pool.connections.begin(), pool.connections.end(), idle);
+
+        connection_ptr conn;
+        if(iter != pool.connections.end())
+        {
+            conn = *iter;
+        }
+        else if(pool.connections.size() < options.max_connections)
+        {
+            conn = std::make_shared<connection>(strand);
+            pool.connections.emplace_back(conn);
+        }
+        else
+        {
+            conn = find_pipeline(pool, *entry);
+            if(conn == nullptr) return;
+        }
+
+        conn->in_flight.emplace_back(entry);
+        pool.waiting.pop_front();
+
+        if(conn->connected) start_write(pool, conn);
+        else if(conn->in_flight.size() == 1) start_connect(pool, conn);
+    }
+}
+
+http_client::connection_ptr http_client::find_pipeline(host_pool& pool, const request_entry& entry)
+{
+    if(options.max_pipeline == 1 or not is_idempotent(entry.request.method())) return nullptr;
+
+    // a request behind one that cannot be retried could get lost with it, so those are left alone
+    const auto safe = [](const auto& conn) {
+        return std::all_of(conn->in_flight.begin(), conn->in_flight.end(),
+                           [](const auto& elem) { return is_idempotent(elem->request.method()); });
+    };
+
+    connection_ptr result;
+    for(const auto& conn : pool.connections)
+    {
+        if(not conn->connected or not conn->reusable or conn->in_flight.size() >= options.max_pipeline) continue;
+        if(result != nullptr and conn->in_flight.size() >= result->in_flight.size()) continue;
+        if(safe(conn)) result = conn;
+    }
+    return result;
+}
+
+void http_client::resolve(host_pool& pool, resolve_handler handler)
+{
+    if(not pool.addresses.empty() and std::chrono::steady_clock::now() < pool.expires)
+    {
+        handler(boost::beast::error_code(), pool.addresses);
+        return;
+    }
+
+    pool.resolving.emplace_back(std::move(handler));
+    if(pool.resolving.size() > 1) return;
+
+    resolver.async_resolve(pool.host, pool.port, [this, &pool](auto error, auto results) {
+        if(not error)
+        {
+            pool.addresses = results;
+            pool.expires   = std::chrono::steady_clock::now() + options.dns_ttl;
+        }
+
+        for(const auto& waiting : std::exchange(pool.resolving, {})) waiting(error, results);
+    });
+}
+
+void http_client::start_connect(host_pool& pool, const connection_ptr& conn)
+{
+    resolve(pool, [this, &pool, conn](auto error, auto results) {
+        if(error)
+        {
+            fail(pool, conn, error);
+            return;
+        }
+
+        conn->stream.expires_after(options.timeout);
+        conn->stream.async_connect(results, [this, &pool, conn](auto error, const auto&) {
+            if(conn->closed) return;
+            if(error)
+            {
+                // the host may have moved, look it up again next time
+                pool.addresses = boost::asio::ip::tcp::resolver::results_type();
+                fail(pool, conn, error);
+                return;
+            }
+
+            conn->connected = true;
+            start_write(pool, conn);
+        });
+    });
+}
+
+void http_client::start_write(host_pool& pool, const connection_ptr& conn)
+{
+    if(conn->writing or conn->closed or conn->written == conn->in_flight.size()) return;
+    conn->writing = true;
+
+    const auto entry = conn->in_flight[conn->written];
+
+    conn->stream.expires_after(options.timeout);
+    http::async_write(conn->stream, entry->request, [this, &pool, conn, entry](auto error, auto) {
+        if(conn->closed) return;
+        conn->writing = false;
+
+        if(error)
+        {
+            fail(pool, conn, error);
+            return;
+        }
+
+        conn->written++;
+        start_read(pool, conn);
+        start_write(pool, conn);
+    });
+}
+
+void http_client::start_read(host_pool& pool, const connection_ptr& conn)
+{
+    if(conn->reading or conn->closed or conn->written == 0) return;
+    conn->reading = true;
+
+    conn->response = response_type();
+    conn->stream.expires_after(options.timeout);
+
+    http::async_read(conn->stream, conn->buffer, conn->response, [this, &pool, conn](auto error, auto) {
+        if(conn->closed) return;
+        conn->reading = false;
+
+        if(error)
+        {
+            fail(pool, conn, error);
+            return;
+        }
+
+        const auto entry = conn->in_flight.front();
+        conn->in_flight.pop_front();
+        conn->written--;
+
+        auto       response   = std::move(conn->response);
+        const auto keep_alive = response.keep_alive();
+        if(entry->done != nullptr) entry->done(boost::beast::error_code(), std::move(response));
+
+        // the server does not look at anything behind it, so those can be sent again as they are
+        if(not keep_alive)
+        {
+            close(pool, conn);
+            pool.waiting.insert(pool.waiting.begin(), conn->in_flight.begin(), conn->in_flight.end());
+            conn->in_flight.clear();
+            pump(pool);
+            return;
+        }
+
+        conn->reusable = true;
+        if(conn->in_flight.empty()) conn->stream.expires_never();
+
+        start_read(pool, conn);
+        pump(pool);
+    });
+}
+
+void http_client::close(host_pool& pool, const connection_ptr& conn)
+{
+    conn->closed = true;
+    conn->stream.close();
+
+    pool.connections.erase(std::remove(pool.connections.begin(), pool.connections.end(), conn), pool.connections.end());
+}
+
+void http_client::fail(host_pool& pool, const connection_ptr& conn, boost::beast::error_code error)
+{
+    close(pool, conn);
+
+    // retried in front of the others, in the order they were sent
+    std::vector<std::shared_ptr<request_entry>> failed;
+    for(auto iter = conn->in_flight.rbegin(); iter != conn->in_flight.rend(); ++iter)
+    {
+        auto& entry = *iter;
+        if(entry->retried or not is_idempotent(entry->request.method()))
+        {
+            failed.emplace_back(entry);
+            continue;
+        }
+
+        entry->retried = true;
+        pool.waiting.emplace_front(entry);
+    }
+    conn->in_flight.clear();
+
+    for(auto iter = failed.rbegin(); iter != failed.rend(); ++iter)
+    {
+        if((*iter)->done != nullptr) (*iter)->done(error, response_type());
+    }
+
+    pump(pool);
+}
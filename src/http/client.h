@@ -0,0 +1,134 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/24/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/strand.hpp>
+#include <boost/beast/core.hpp>
+#include <boost/beast/http.hpp>
+
+namespace http = boost::beast::http;
+
+struct client_options
+{
+    // connections kept open to a single host
+    size_t max_connections = 4;
+
+    // requests written on one connection before the first one is answered,
+    // only for requests that can safely be sent twice
+    size_t max_pipeline = 4;
+
+    // the resolver does not tell us how long an address is valid, so we pick something
+    std::chrono::seconds dns_ttl = std::chrono::seconds(300);
+
+    // for every connect, write and read on its own
+    std::chrono::seconds timeout = std::chrono::seconds(30);
+};
+
+// An asynchronous http client that keeps its connections open. Every host gets
+// a pool of connections and its resolved addresses are remembered. A request
+// that can safely be sent twice is retried once on a new connection when the
+// one it was on closed underneath it, which is how a server ends keep-alive.
+// All functions can be called from any thread, callbacks are called from the
+// client's strand and should not block.
+class http_client
+{
+    public:
+    using request_type  = http::request<http::string_body>;
+    using response_type = http::response<http::string_body>;
+    using callback      = std::function<void(boost::beast::error_code, response_type)>;
+
+    explicit http_client(boost::asio::io_context& context, client_options options = client_options());
+
+    http_client(const http_client&) = delete;
+
+    http_client operator=(const http_client&) = delete;
+
+    // the host field is filled in if the request does not have one
+    void async_request(const std::string& host, const std::string& port, request_type request, callback done);
+
+    // the error comes out of the future as a boost::system::system_error
+    std::future<response_type> request(const std::string& host, const std::string& port, request_type request);
+
+    private:
+    struct request_entry
+    {
+        request_type request;
+        callback     done;
+        bool         retried = false;
+    };
+
+    struct connection
+    {
+        explicit connection(boost::asio::strand<boost::asio::io_context::executor_type>& strand) : stream(strand) {}
+
+        boost::beast::tcp_stream   stream;
+        boost::beast::flat_buffer  buffer;
+        response_type              response;
+
+        // answered in the order they were written, the first few of them are written already
+        std::deque<std::shared_ptr<request_entry>> in_flight;
+        size_t                                     written = 0;
+
+        bool connected = false;
+        bool closed    = false;
+        bool writing   = false;
+        bool reading   = false;
+        bool reusable  = false; // the server kept it open after an answer, so it understands keep-alive
+    };
+
+    using connection_ptr  = std::shared_ptr<connection>;
+    using resolve_handler = std::function<void(boost::beast::error_code, boost::asio::ip::tcp::resolver::results_type)>;
+
+    struct host_pool
+    {
+        std::string host;
+        std::string port;
+
+        std::vector<connection_ptr>                connections;
+        std::deque<std::shared_ptr<request_entry>> waiting;
+
+        boost::asio::ip::tcp::resolver::results_type addresses;
+        std::chrono::steady_clock::time_point        expires;
+        std::vector<resolve_handler>                 resolving; // everyone waiting on the lookup that is going on
+    };
+
+    // these run on the strand
+    void pump(host_pool& pool);
+
+    connection_ptr find_pipeline(host_pool& pool, const request_entry& entry);
+
+    void resolve(host_pool& pool, resolve_handler handler);
+
+    void start_connect(host_pool& pool, const connection_ptr& conn);
+
+    void start_write(host_pool& pool, const connection_ptr& conn);
+
+    void start_read(host_pool& pool, const connection_ptr& conn);
+
+    void close(host_pool& pool, const connection_ptr& conn);
+
+    // closes the connection, what was not answered yet is retried or fails with the error
+    void fail(host_pool& pool, const connection_ptr& conn, boost::beast::error_code error);
+
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+    boost::asio::ip::tcp::resolver                               resolver;
+    client_options                                               options;
+
+    // by host and port, never removed so the handlers can hold on to them
+    std::unordered_map<std::string, host_pool> pools;
+};
@@ -9,45 +9,49 @@
 
 #include "helper.h"
 
-http_requester::http_requester(std::string host_name) : stream(ioc), host(std::move(host_name))
+http_requester::http_requester(std::string host_name, std::string port, client_options options)
+: ioc(), work(boost::asio::make_work_guard(ioc)), client(ioc, options), host(std::move(host_name)), port(std::move(port))
 {
-    // These objects perform our I/O
-    boost::asio::ip::tcp::resolver resolver(ioc);
-
-    // Look up the domain name
-    const auto results = resolver.resolve(host, port);
-
-    // Make the connection on the IP address we get from a lookup
-    stream.connect(results);
+    // the connection is only made once the first request needs it
+    thread = std::thread([this]() { ioc.run(); });
 }
 
 http_requester::~http_requester()
 {
-    boost::beast::error_code ec;
-    stream.socket().shutdown(boost::asio::ip::tcp::socket::shutdown_both, ec);
+    work.reset();
+    ioc.stop();
+    thread.join();
 }
 
-http::response<http::string_body> http_requester::get_response(const std::string& target)
+void http_requester::async_get(const std::string& target, http_client::callback done)
 {
-    // Set up an HTTP GET request message
-    http::request<http::string_body> request{http::verb::get, target, version};
-    request.set(http::field::host, host);
-    request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
-
-    // Send the HTTP request to the remote host
-    http::write(stream, request);
+    client.async_request(host, port, make_request(target), std::move(done));
+}
 
-    // Declare a container to hold the response
-    http::response<boost::beast::http::string_body> response;
+void http_requester::async_get(const target_builder& builder, http_client::callback done)
+{
+    async_get(builder.string(), std::move(done));
+}
 
-    // Receive the HTTP response
-    http::read(stream, buffer, response);
+void http_requester::async_request(http_client::request_type request, http_client::callback done)
+{
+    client.async_request(host, port, std::move(request), std::move(done));
+}
 
-    // Return the request
-    return response;
+std::future<http_requester::response_type> http_requester::get_response(const std::string& target)
+{
+    return client.request(host, port, make_request(target));
 }
 
-http::response<http::string_body> http_requester::get_response(const target_builder& builder)
+std::future<http_requester::response_type> http_requester::get_response(const target_builder& builder)
 {
     return get_response(builder.string());
-}
\ No newline at end of file
+}
+
+http_client::request_type http_requester::make_request(const std::string& target) const
+{
+    http_client::request_type request{ http::verb::get, target, version };
+    request.set(http::field::host, host);
+    request.set(http::field::user_agent, BOOST_BEAST_VERSION_STRING);
+    return request;
+}
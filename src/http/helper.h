@@ -10,61 +10,160 @@
 
 #pragma once
 
-#include <boost/asio/connect.hpp>
-#include <boost/asio/ip/tcp.hpp>
-#include <boost/beast/core.hpp>
-#include <boost/beast/http.hpp>
+#include <array>
+#include <charconv>
+#include <future>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <boost/asio/executor_work_guard.hpp>
+#include <boost/asio/io_context.hpp>
 #include <boost/beast/version.hpp>
 
+#include "client.h"
+
+namespace detail
+{
+// the characters a query value can hold as they are: the unreserved ones, and the comma that separates lists
+constexpr auto plain_characters = []() {
+    std::array<bool, 256> result{};
+    for(char c = 'a'; c <= 'z'; c++) result[static_cast<unsigned char>(c)] = true;
+    for(char c = 'A'; c <= 'Z'; c++) result[static_cast<unsigned char>(c)] = true;
+    for(char c = '0'; c <= '9'; c++) result[static_cast<unsigned char>(c)] = true;
+    for(char c : { '-', '_', '.', '~', ',' }) result[static_cast<unsigned char>(c)] = true;
+    return result;
+}();
+
+constexpr auto hex_digits = "0123456789ABCDEF";
+
+template <typename Type>
+struct is_vector : std::false_type {};
+
+template <typename Type>
+struct is_vector<std::vector<Type>> : std::true_type {};
+
+} // namespace detail
+
+// Builds a target with a query, every key and value is percent-encoded. Values
+// can be strings, booleans (true or false), integers or vectors of integers,
+// which become a comma separated list.
+// Give it the expected length and it does not have to grow while building.
 class target_builder
 {
     public:
-    explicit target_builder(std::string path) : result(std::move(path)) {}
+    explicit target_builder(std::string path, size_t expected_size = 0) : result(std::move(path))
+    {
+        result.reserve(result.size() + expected_size);
+    }
 
     template <typename Type>
-    target_builder& operator()(const std::string& key, const Type& value)
+    target_builder& operator()(std::string_view key, const Type& value)
     {
-        if(not first) result += '&';
-        else
-            result += '?';
+        result += first ? '?' : '&';
         first = false;
 
-        result += key;
+        append_encoded(key);
         result += '=';
 
-        if constexpr(std::is_same_v<std::decay_t<Type>, char*> or std::is_same_v<Type, std::string>)
-            result += value;
+        if constexpr(std::is_same_v<Type, bool>)
+        {
+            result += value ? "true" : "false";
+        }
+        else if constexpr(std::is_integral_v<Type>)
+        {
+            append_integer(value);
+        }
+        else if constexpr(detail::is_vector<Type>::value)
+        {
+            using Element = typename Type::value_type;
+            static_assert(std::is_integral_v<Element> and not std::is_same_v<Element, bool>, "only lists of integers can be joined");
+
+            result.reserve(result.size() + value.size() * (std::numeric_limits<Element>::digits10 + 3));
+            for(size_t i = 0; i < value.size(); i++)
+            {
+                if(i != 0) result += ',';
+                append_integer(value[i]);
+            }
+        }
         else
-            result += std::to_string(value);
+        {
+            append_encoded(std::string_view(value));
+        }
 
         return *this;
     }
 
-    std::string string() const { return result; }
+    [[nodiscard]] const std::string& string() const { return result; }
 
     private:
+    template <typename Type>
+    void append_integer(Type value)
+    {
+        std::array<char, std::numeric_limits<Type>::digits10 + 3> buffer;
+        const auto [end, error] = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+        result.append(buffer.data(), end);
+    }
+
+    void append_encoded(std::string_view value)
+    {
+        // grown once for the worst case and cut back after
+        const auto size = result.size();
+        result.resize(size + 3 * value.size());
+
+        auto iter = result.begin() + static_cast<std::ptrdiff_t>(size);
+        for(const auto elem : value)
+        {
+            const auto c = static_cast<unsigned char>(elem);
+            if(detail::plain_characters[c])
+            {
+                *iter++ = elem;
+                continue;
+            }
+            *iter++ = '%';
+            *iter++ = detail::hex_digits[c >> 4];
+            *iter++ = detail::hex_digits[c & 0xF];
+        }
+        result.erase(iter, result.end());
+    }
+
     bool first = true;
     std::string result;
 };
 
-namespace http = boost::beast::http;
-
+// Requests to a single host, on a client with a thread of its own. Nothing
+// here blocks, callbacks are called from that thread and should not block it.
 class http_requester
 {
     public:
-    explicit http_requester(std::string host_name);
+    using response_type = http_client::response_type;
+
+    explicit http_requester(std::string host_name, std::string port = "80", client_options options = client_options());
     ~http_requester();
 
-    http::response<http::string_body> get_response(const std::string& target);
-    http::response<http::string_body> get_response(const target_builder& builder);
+    void async_get(const std::string& target, http_client::callback done);
+    void async_get(const target_builder& builder, http_client::callback done);
+
+    std::future<response_type> get_response(const std::string& target);
+    std::future<response_type> get_response(const target_builder& builder);
+
+    // a get request for this host, for when it needs some more fields before it is sent
+    [[nodiscard]] http_client::request_type make_request(const std::string& target) const;
+
+    void async_request(http_client::request_type request, http_client::callback done);
 
     private:
-    boost::asio::io_context ioc;
-    boost::beast::flat_buffer buffer;
-    boost::beast::tcp_stream stream;
+
+    boost::asio::io_context                                                  ioc;
+    boost::asio::executor_work_guard<boost::asio::io_context::executor_type> work;
+    http_client                                                              client;
 
     std::string host;
+    std::string port;
+    std::thread thread;
 
-    constexpr static auto port = "80";
     constexpr static auto version = 11;
 };
@@ -0,0 +1,251 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/25/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "cache.h"
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <optional>
+#include <string_view>
+#include <nlohmann/json.h>
+
+namespace
+{
+std::string endpoint_of(const std::string& target)
+{
+    return target.substr(0, target.find('?'));
+}
+
+// the target without its key parameter, so the api key never ends up in the cache file.
+// Answers do not depend on whose key asked for them, so they can be shared as well
+std::string cache_key(const std::string& target)
+{
+    const auto query = target.find('?');
+    if(query == std::string::npos) return target;
+
+    auto result = target.substr(0, query);
+    auto first  = true;
+    for(size_t begin = query + 1; begin <= target.size();)
+    {
+        const auto end       = std::min(target.find('&', begin), target.size());
+        const auto parameter = std::string_view(target).substr(begin, end - begin);
+        begin                = end + 1;
+
+        if(parameter.empty() or parameter.substr(0, parameter.find('=')) == "key") continue;
+
+        result += first ? '?' : '&';
+        result += parameter;
+        first = false;
+    }
+    return result;
+}
+
+bool can_revalidate(const http_requester::response_type& response)
+{
+    return response.find(http::field::etag) != response.end() or response.find(http::field::last_modified) != response.end();
+}
+
+} // namespace
+
+namespace steam
+{
+
+response_cache::response_cache(policies endpoint_policies, std::filesystem::path path)
+: endpoint_policies(std::move(endpoint_policies)), path(std::move(path)), mutex(), entries(), statistics()
+{
+    load();
+}
+
+response_cache::~response_cache()
+{
+    store();
+}
+
+void response_cache::get(http_requester& requester, const std::string& target, http_client::callback done)
+{
+    const auto policy = find_policy(target);
+    if(policy == nullptr)
+    {
+        requester.async_get(target, std::move(done));
+        return;
+    }
+
+    auto                                         request = requester.make_request(target);
+    auto                                         key     = cache_key(target);
+    std::optional<http_requester::response_type> hit;
+    {
+        const auto lock  = std::lock_guard(mutex);
+        auto&      entry = entries[key];
+
+        if(entry.valid and clock::now() < entry.expires)
+        {
+            statistics.hits++;
+            hit = entry.response;
+        }
+        else
+        {
+            entry.waiting.emplace_back(std::move(done));
+            if(entry.waiting.size() > 1)
+            {
+                statistics.coalesced++;
+                return;
+            }
+            statistics.misses++;
+
+            if(entry.valid)
+            {
+                const auto etag          = entry.response.find(http::field::etag);
+                const auto last_modified = entry.response.find(http::field::last_modified);
+
+                if(etag != entry.response.end()) request.set(http::field::if_none_match, etag->value());
+                if(last_modified != entry.response.end()) request.set(http::field::if_modified_since, last_modified->value());
+            }
+        }
+    }
+
+    // not under the lock, the callback may well ask for something else
+    if(hit)
+    {
+        if(done != nullptr) done(boost::beast::error_code(), std::move(*hit));
+        return;
+    }
+
+    requester.async_request(std::move(request), [this, key = std::move(key)](auto error, auto response) {
+        handle_response(key, error, std::move(response));
+    });
+}
+
+cache_stats response_cache::stats() const
+{
+    const auto lock = std::lock_guard(mutex);
+    return statistics;
+}
+
+void response_cache::handle_response(const std::string& key, boost::beast::error_code error, http_requester::response_type response)
+{
+    std::vector<http_client::callback> waiting;
+    {
+        const auto lock  = std::lock_guard(mutex);
+        auto&      entry = entries[key];
+        waiting.swap(entry.waiting);
+
+        const auto policy = find_policy(key);
+        if(not error and entry.valid and response.result() == http::status::not_modified)
+        {
+            statistics.revalidated++;
+            entry.expires = clock::now() + policy->ttl;
+            response      = entry.response;
+        }
+        else if(not error and response.result() == http::status::ok)
+        {
+            entry.response = response;
+            entry.valid    = true;
+            entry.expires  = clock::now() + policy->ttl;
+        }
+
+        if(entries.size() > prune_size) prune();
+    }
+
+    // everyone gets their own copy, they are free to move out of it
+    for(const auto& done : waiting)
+    {
+        if(done != nullptr) done(error, response);
+    }
+}
+
+void response_cache::prune()
+{
+    const auto now = clock::now();
+    for(auto iter = entries.begin(); iter != entries.end();)
+    {
+        const auto& entry   = iter->second;
+        const auto  expired = not entry.valid or (entry.expires < now and not can_revalidate(entry.response));
+
+        if(expired and entry.waiting.empty()) iter = entries.erase(iter);
+        else ++iter;
+    }
+}
+
+void response_cache::load()
+{
+    if(path.empty() or not std::filesystem::exists(path)) return;
+
+    try
+    {
+        std::ifstream file(path);
+        const auto    json = nlohmann::json::parse(file);
+
+        for(const auto& elem : json)
+        {
+            http_requester::response_type response{ static_cast<http::status>(elem["status"].get<unsigned>()), 11 };
+            response.body() = elem["body"].get<std::string>();
+
+            const auto etag          = elem["etag"].get<std::string>();
+            const auto last_modified = elem["last_modified"].get<std::string>();
+            if(not etag.empty()) response.set(http::field::etag, etag);
+            if(not last_modified.empty()) response.set(http::field::last_modified, last_modified);
+
+            // files of older versions still have the key in the targets, it is gone on the next store
+            auto& entry    = entries[cache_key(elem["target"].get<std::string>())];
+            entry.response = std::move(response);
+            entry.valid    = true;
+            entry.expires  = clock::time_point(std::chrono::seconds(elem["expires"].get<int64_t>()));
+        }
+    }
+    catch(const std::exception& exception)
+    {
+        std::cout << "could not read response cache " << path << ": " << exception.what() << '\n';
+        entries.clear();
+    }
+}
+
+void response_cache::store() const
+{
+    if(path.empty()) return;
+
+    auto json = nlohmann::json::array();
+    {
+        const auto lock = std::lock_guard(mutex);
+        for(const auto& [key, entry] : entries)
+        {
+            const auto policy = find_policy(key);
+            if(not entry.valid or policy == nullptr or not policy->persistent) continue;
+
+            const auto etag          = entry.response.find(http::field::etag);
+            const auto last_modified = entry.response.find(http::field::last_modified);
+            const auto expires       = std::chrono::duration_cast<std::chrono::seconds>(entry.expires.time_since_epoch());
+
+            json.push_back({ { "target", key },
+                             { "status", entry.response.result_int() },
+                             { "etag", etag == entry.response.end() ? "" : std::string(etag->value()) },
+                             { "last_modified", last_modified == entry.response.end() ? "" : std::string(last_modified->value()) },
+                             { "expires", expires.count() },
+                             { "body", entry.response.body() } });
+        }
+    }
+
+    // written next to it first, so a crash halfway leaves the old file
+    auto temporary = path;
+    temporary += ".tmp";
+
+    std::ofstream file(temporary, std::ios::trunc);
+    file << json;
+    file.close();
+
+    std::error_code error;
+    if(file) std::filesystem::rename(temporary, path, error);
+    if(not file or error) std::cout << "could not write response cache " << path << '\n';
+}
+
+const cache_policy* response_cache::find_policy(const std::string& target) const
+{
+    const auto iter = endpoint_policies.find(endpoint_of(target));
+    if(iter == endpoint_policies.end() or iter->second.ttl.count() <= 0) return nullptr;
+    return &iter->second;
+}
+
+} // namespace steam
@@ -0,0 +1,100 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/25/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../http/helper.h"
+
+namespace steam
+{
+
+struct cache_policy
+{
+    // how long an answer is used without asking again
+    std::chrono::seconds ttl = std::chrono::seconds(0);
+
+    // kept in the cache file, for answers that are worth keeping across restarts
+    bool persistent = false;
+};
+
+struct cache_stats
+{
+    uint64_t hits        = 0; // answered from the cache
+    uint64_t misses      = 0; // sent to the server
+    uint64_t revalidated = 0; // misses the server answered with not modified
+    uint64_t coalesced   = 0; // waited on an identical request that was already going
+};
+
+// Answers to get requests by their target, which includes the query except for
+// the api key, so that never ends up in the cache file. Every endpoint, the
+// target without its query, has its own policy. Endpoints without a policy are
+// not cached. An expired answer that came with an ETag or Last-Modified is asked
+// for again conditionally, so the server can answer with not modified instead of
+// the whole body. Identical requests that come in while one is going share its answer.
+// It can be used from any thread.
+class response_cache
+{
+    public:
+    using policies = std::unordered_map<std::string, cache_policy>;
+
+    // nothing is read or written if the path is empty
+    explicit response_cache(policies endpoint_policies, std::filesystem::path path = std::filesystem::path());
+
+    ~response_cache();
+
+    response_cache(const response_cache&) = delete;
+
+    response_cache operator=(const response_cache&) = delete;
+
+    // the requester has to be done with its callbacks before the cache is destroyed
+    void get(http_requester& requester, const std::string& target, http_client::callback done);
+
+    [[nodiscard]] cache_stats stats() const;
+
+    private:
+    using clock = std::chrono::system_clock;
+
+    struct entry
+    {
+        http_requester::response_type response;
+        bool                          valid = false;
+        clock::time_point             expires;
+
+        // everyone waiting on the request that is going on, which is none if this is empty
+        std::vector<http_client::callback> waiting;
+    };
+
+    // the key is the target without its api key
+    void handle_response(const std::string& key, boost::beast::error_code error, http_requester::response_type response);
+
+    // forgets expired answers the server cannot revalidate, the lock should be held
+    void prune();
+
+    void load();
+
+    void store() const;
+
+    [[nodiscard]] const cache_policy* find_policy(const std::string& target) const;
+
+    policies              endpoint_policies;
+    std::filesystem::path path;
+
+    mutable std::mutex                     mutex;
+    std::unordered_map<std::string, entry> entries;
+    cache_stats                            statistics;
+
+    constexpr static size_t prune_size = 1024;
+};
+
+} // namespace steam
@@ -9,127 +9,285 @@
 
 #include "requester.h"
 
-#include <boost/algorithm/string/join.hpp>
-#include <boost/range/adaptor/transformed.hpp>
+#include <algorithm>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
 
 namespace steam
 {
 
-requester::requester() : req("api.steampowered.com") {}
+namespace
+{
+// turns the answer into a value with the parser, anything that goes wrong ends up in the error
+template <typename Type, typename Parser>
+void deliver(const callback<Type>&                done,
+             boost::beast::error_code             error,
+             const http_requester::response_type& response,
+             Parser                               parse)
+{
+    if(done == nullptr) return;
+
+    Type               result;
+    std::exception_ptr failure;
+    try
+    {
+        if(error) throw boost::system::system_error(error);
+        if(response.result() != http::status::ok)
+            throw std::runtime_error("steam answered with status " + std::to_string(response.result_int()));
+
+        result = parse(nlohmann::json::parse(response.body()));
+    }
+    catch(...)
+    {
+        failure = std::current_exception();
+        result  = Type();
+    }
+    done(failure, std::move(result));
+}
+
+} // namespace
+
+requester::requester() : requester(std::make_shared<response_cache>(default_policies())) {}
+
+requester::requester(std::shared_ptr<response_cache> cache) : cache(std::move(cache)), req("api.steampowered.com") {}
 
-std::vector<steam_friend> requester::get_friends(const std::string& key, uint64_t steam_id)
+response_cache::policies requester::default_policies()
+{
+    using namespace std::chrono_literals;
+    return {
+            { "/ISteamUserStats/GetSchemaForGame/v2/", { 24h, true } },
+            { "/ISteamUser/GetPlayerSummaries/v0002/", { 10s, false } },
+            { "/ISteamUser/GetFriendList/v0001/", { 60s, false } },
+            { "/IPlayerService/GetRecentlyPlayedGames/v0001/", { 60s, false } },
+    };
+}
+
+cache_stats requester::cache_statistics() const
+{
+    return cache == nullptr ? cache_stats() : cache->stats();
+}
+
+void requester::fetch(const target_builder& builder, http_client::callback done)
+{
+    if(cache == nullptr) req.async_get(builder, std::move(done));
+    else cache->get(req, builder.string(), std::move(done));
+}
+
+void requester::get_friends(const std::string& key, uint64_t steam_id, callback<std::vector<steam_friend>> done)
 {
     target_builder builder("/ISteamUser/GetFriendList/v0001/");
     builder("key", key)("steamid", steam_id);
 
-    const auto response = req.get_response(builder);
-    const auto json = nlohmann::json::parse(response.body());
+    const auto parse = [](const nlohmann::json& json) {
+        std::vector<steam_friend> friends;
+        for(const auto& elem : json["friendslist"]["friends"])
+        {
+            steam_friend sf =
+                    {
+                            std::stoul(elem["steamid"].get<std::string>()),
+                            std::chrono::seconds(elem["friend_since"])
+                    };
+            friends.emplace_back(sf);
+        }
+        return friends;
+    };
 
-    std::vector<steam_friend> friends;
-    for(const auto& elem : json["friendslist"]["friends"])
-    {
-        steam_friend sf =
-                {
-                        std::stoul(elem["steamid"].get<std::string>()),
-                        std::chrono::seconds(elem["friend_since"])
-                };
-        friends.emplace_back(sf);
-    }
-    return friends;
+    fetch(builder, [done = std::move(done), parse](auto error, auto response) {
+        deliver(done, error, response, parse);
+    });
 }
 
-game_info requester::get_game_info(const std::string& key, uint64_t game_id)
+void requester::get_game_info(const std::string& key, uint64_t game_id, callback<game_info> done)
 {
     target_builder builder("/ISteamUserStats/GetSchemaForGame/v2/");
     builder("key", key)("appid", game_id);
 
-    const auto response = req.get_response(builder);
-    const auto json = nlohmann::json::parse(response.body());
+    const auto parse = [](const nlohmann::json& json) {
+        return game_info{json["game"]["gameName"], json["game"]["gameVersion"]};
+    };
 
-    return {json["game"]["gameName"], json["game"]["gameVersion"]};
+    fetch(builder, [done = std::move(done), parse](auto error, auto response) {
+        deliver(done, error, response, parse);
+    });
 }
 
-std::vector<player_summary> requester::get_player_summaries(const std::string& key, const std::vector<uint64_t>& steam_ids)
+void requester::get_player_summaries(const std::string&           key,
+                                     const std::vector<uint64_t>& steam_ids,
+                                     callback<summaries_report>   done)
 {
-    const auto func = static_cast<std::string(*)(uint64_t)>(std::to_string);
-    target_builder builder("/ISteamUser/GetPlayerSummaries/v0002/");
-    builder("key", key)("steamids", boost::join(steam_ids | boost::adaptors::transformed(func), ","));
+    struct run
+    {
+        std::vector<uint64_t>                    ids; // without duplicates, in the order they were asked
+        std::vector<std::vector<player_summary>> chunks;
+        summaries_report                         report;
+        callback<summaries_report>               done;
 
-    const auto response = req.get_response(builder);
-    const auto json = nlohmann::json::parse(response.body());
+        // the chunks are answered from the http thread, but they are counted anyway
+        std::mutex mutex;
+        size_t     remaining;
+    };
 
-    std::vector<player_summary> summaries;
-    for(const auto& elem : json["response"]["players"])
+    auto state = std::make_shared<run>();
+    state->done = std::move(done);
+
+    std::unordered_set<uint64_t> seen;
+    for(const auto id : steam_ids)
+    {
+        if(seen.insert(id).second) state->ids.emplace_back(id);
+    }
+
+    const auto count = (state->ids.size() + max_summary_ids - 1) / max_summary_ids;
+    if(count == 0)
+    {
+        if(state->done != nullptr) state->done(nullptr, summaries_report());
+        return;
+    }
+
+    state->chunks.resize(count);
+    state->report.failures.resize(count);
+    state->remaining = count;
+
+    // steam answers in any order, so everything is put back in the order it was asked once the last chunk is in
+    const auto merge = [](run& state) {
+        std::unordered_map<uint64_t, player_summary*> found;
+        for(auto& chunk : state.chunks)
+        {
+            for(auto& summary : chunk) found.emplace(summary.steam_id, &summary);
+        }
+
+        state.report.summaries.reserve(found.size());
+        for(const auto id : state.ids)
+        {
+            const auto iter = found.find(id);
+            if(iter != found.end()) state.report.summaries.emplace_back(std::move(*iter->second));
+        }
+
+        const auto failed = std::find_if(state.report.failures.begin(), state.report.failures.end(),
+                                         [](const auto& elem) { return elem != nullptr; });
+        if(state.done != nullptr) state.done(failed == state.report.failures.end() ? nullptr : *failed, std::move(state.report));
+    };
+
+    for(size_t i = 0; i < count; i++)
     {
-        player_summary summary =
-                {
-                        std::stoul(elem["steamid"].get<std::string>()),
-                        elem["personaname"].get<std::string>(),
-                        elem["personastate"].get<persona_state>(),
-                        std::chrono::seconds(elem["lastlogoff"]),
-                        elem.find("gameid") == elem.end() ? -1 : std::stol(elem["gameid"].get<std::string>()),
-                        elem.find("gameextrainfo") == elem.end() ? "" : elem["gameextrainfo"].get<std::string>()
-                };
-
-        summaries.emplace_back(std::move(summary));
+        const auto begin = state->ids.begin() + static_cast<std::ptrdiff_t>(i * max_summary_ids);
+        const auto end   = state->ids.begin() + static_cast<std::ptrdiff_t>(std::min((i + 1) * max_summary_ids, state->ids.size()));
+
+        get_summary_chunk(key, std::vector<uint64_t>(begin, end), [state, i, merge](auto error, auto summaries) {
+            {
+                const auto lock          = std::lock_guard(state->mutex);
+                state->chunks[i]          = std::move(summaries);
+                state->report.failures[i] = error;
+                if(--state->remaining != 0) return;
+            }
+            merge(*state);
+        });
     }
-    return summaries;
 }
 
-std::vector<play_info> requester::get_recently_played(const std::string& key, uint64_t steam_id)
+void requester::get_summary_chunk(const std::string&           key,
+                                  const std::vector<uint64_t>& steam_ids,
+                                  callback<std::vector<player_summary>> done)
+{
+    // every id is at most 20 digits and a comma
+    target_builder builder("/ISteamUser/GetPlayerSummaries/v0002/", 64 + key.size() * 3 + steam_ids.size() * 21);
+    builder("key", key)("steamids", steam_ids);
+
+    const auto parse = [](const nlohmann::json& json) {
+        std::vector<player_summary> summaries;
+        for(const auto& elem : json["response"]["players"])
+        {
+            player_summary summary =
+                    {
+                            std::stoul(elem["steamid"].get<std::string>()),
+                            elem["personaname"].get<std::string>(),
+                            elem["personastate"].get<persona_state>(),
+                            std::chrono::seconds(elem["lastlogoff"]),
+                            elem.find("gameid") == elem.end() ? -1 : std::stol(elem["gameid"].get<std::string>()),
+                            elem.find("gameextrainfo") == elem.end() ? "" : elem["gameextrainfo"].get<std::string>()
+                    };
+
+            summaries.emplace_back(std::move(summary));
+        }
+        return summaries;
+    };
+
+    fetch(builder, [done = std::move(done), parse](auto error, auto response) {
+        deliver(done, error, response, parse);
+    });
+}
+
+void requester::get_recently_played(const std::string& key, uint64_t steam_id, callback<std::vector<play_info>> done)
 {
     target_builder builder("/IPlayerService/GetRecentlyPlayedGames/v0001/");
     builder("key", key)("steamid", steam_id);
 
-    const auto response = req.get_response(builder);
-    const auto json = nlohmann::json::parse(response.body());
+    const auto parse = [](const nlohmann::json& json) {
+        std::vector<play_info> infos;
+        for(const auto& elem : json["response"]["games"])
+        {
+            play_info info =
+                    {
+                            elem["appid"],
+                            elem["name"],
+                            std::chrono::minutes(elem["playtime_2weeks"]),
+                            std::chrono::minutes(elem["playtime_forever"]),
+                            std::chrono::minutes(elem["playtime_windows_forever"]),
+                            std::chrono::minutes(elem["playtime_linux_forever"]),
+                            std::chrono::minutes(elem["playtime_mac_forever"])
+                    };
+            infos.emplace_back(std::move(info));
+        }
+        return infos;
+    };
 
-    std::vector<play_info> infos;
-    for(const auto& elem : json["response"]["games"])
-    {
-        play_info info =
-                {
-                        elem["appid"],
-                        elem["name"],
-                        std::chrono::minutes(elem["playtime_2weeks"]),
-                        std::chrono::minutes(elem["playtime_forever"]),
-                        std::chrono::minutes(elem["playtime_windows_forever"]),
-                        std::chrono::minutes(elem["playtime_linux_forever"]),
-                        std::chrono::minutes(elem["playtime_mac_forever"])
-                };
-        infos.emplace_back(std::move(info));
-    }
-
-    return infos;
+    fetch(builder, [done = std::move(done), parse](auto error, auto response) {
+        deliver(done, error, response, parse);
+    });
 }
 
-std::vector<player_summary> requester::get_friends_playing_same_game(const std::string& key, uint64_t steam_id)
+void requester::get_friends_playing_same_game(const std::string& key, uint64_t steam_id, callback<std::vector<player_summary>> done)
 {
-    const auto friends = get_friends(key, steam_id);
+    const auto same_game = [steam_id](const std::vector<player_summary>& summaries) {
+        const auto comp = [&](const auto& elem){ return elem.steam_id == steam_id; };
+        const auto iter = std::find_if(summaries.begin(), summaries.end(), comp);
 
-    std::vector<uint64_t> steam_ids;
-    steam_ids.emplace_back(steam_id);
-    for(const auto& elem : friends) steam_ids.emplace_back(elem.steam_id);
+        if(iter == summaries.end()) return std::vector<player_summary>();
+        const auto summary = *iter;
 
-    const auto summaries = get_player_summaries(key, steam_ids);
+        if(summary.state == persona_state::offline or summary.game_id == -1) return std::vector<player_summary>();
 
-    const auto comp = [&](const auto& elem){ return elem.steam_id == steam_id; };
-    const auto iter = std::find_if(summaries.begin(), summaries.end(), comp);
+        std::vector<player_summary> result;
+        for(const auto& elem : summaries)
+        {
+            if(elem.steam_id == summary.steam_id) continue;
+            if(elem.state == persona_state::offline) continue;
+            if(elem.game_id != summary.game_id) continue;
+            result.emplace_back(elem);
+        }
+        return result;
+    };
 
-    if(iter == summaries.end()) return {};
-    const auto summary = *iter;
+    get_friends(key, steam_id, [this, key, steam_id, done = std::move(done), same_game](auto error, auto friends) {
+        if(error)
+        {
+            if(done != nullptr) done(error, {});
+            return;
+        }
 
-    if(summary.state == persona_state::offline or summary.game_id == -1) return {};
+        std::vector<uint64_t> steam_ids;
+        steam_ids.emplace_back(steam_id);
+        for(const auto& elem : friends) steam_ids.emplace_back(elem.steam_id);
 
-    std::vector<player_summary> result;
-    for(const auto& elem : summaries)
-    {
-        if(elem.steam_id == summary.steam_id) continue;
-        if(elem.state == persona_state::offline) continue;
-        if(elem.game_id != summary.game_id) continue;
-        result.emplace_back(elem);
-    }
-    return result;
+        // a friend whose chunk failed is left out, but without our own summary there is nothing to compare
+        get_player_summaries(key, steam_ids, [done, same_game](auto error, auto report) {
+            if(done == nullptr) return;
+
+            const auto has_own = not report.failures.empty() and report.failures.front() == nullptr;
+            if(not has_own) done(error, {});
+            else done(nullptr, same_game(report.summaries));
+        });
+    });
 }
 
 }
\ No newline at end of file
@@ -11,11 +11,15 @@
 #pragma once
 
 #include <chrono>
+#include <exception>
+#include <functional>
 #include <iostream>
+#include <memory>
 #include <nlohmann/json.h>
 #include <vector>
 
 #include "../http/helper.h"
+#include "cache.h"
 
 
 namespace steam
@@ -69,24 +73,60 @@ struct play_info
     std::chrono::minutes playtime_mac;
 };
 
+struct summaries_report
+{
+    // in the order the ids were asked for, ids steam does not know or of which the chunk failed are left out
+    std::vector<player_summary> summaries;
+
+    // per chunk of at most max_summary_ids ids in the order they were asked, empty for the ones that worked
+    std::vector<std::exception_ptr> failures;
+};
+
+// the error is set when the request failed or the answer could not be read, the value is empty then
+template <typename Type>
+using callback = std::function<void(std::exception_ptr, Type)>;
+
+// Every call returns right away, the callback is called from the http thread.
 class requester
 {
     public:
+    // answers are cached as long as default_policies says, nothing is kept on disk
     requester();
 
-    std::vector<steam_friend> get_friends(const std::string& key, uint64_t steam_id);
+    // no caching at all without a cache
+    explicit requester(std::shared_ptr<response_cache> cache);
+
+    // game schemas for a day and kept on disk, summaries for a few seconds, the rest for a minute
+    static response_cache::policies default_policies();
 
-    game_info get_game_info(const std::string& key, uint64_t game_id);
+    [[nodiscard]] cache_stats cache_statistics() const;
 
-    std::vector<player_summary>
-    get_player_summaries(const std::string& key, const std::vector<uint64_t>& steam_ids);
+    void get_friends(const std::string& key, uint64_t steam_id, callback<std::vector<steam_friend>> done);
 
-    std::vector<play_info> get_recently_played(const std::string& key, uint64_t steam_id);
+    void get_game_info(const std::string& key, uint64_t game_id, callback<game_info> done);
 
-    std::vector<player_summary> get_friends_playing_same_game(const std::string& key, uint64_t steam_id);
+    // steam takes at most max_summary_ids ids at a time, more are asked for in chunks that all go at once,
+    // the error is that of the first chunk that failed, the report still has everything the others found
+    void get_player_summaries(const std::string&           key,
+                              const std::vector<uint64_t>& steam_ids,
+                              callback<summaries_report>   done);
+
+    void get_recently_played(const std::string& key, uint64_t steam_id, callback<std::vector<play_info>> done);
+
+    void get_friends_playing_same_game(const std::string& key, uint64_t steam_id, callback<std::vector<player_summary>> done);
+
+    constexpr static size_t max_summary_ids = 100;
 
     private:
-    http_requester req;
+    void get_summary_chunk(const std::string&           key,
+                           const std::vector<uint64_t>& steam_ids,
+                           callback<std::vector<player_summary>> done);
+
+    void fetch(const target_builder& builder, http_client::callback done);
+
+    // declared first, so the requester is done with its callbacks when the cache goes
+    std::shared_ptr<response_cache> cache;
+    http_requester                  req;
 };
 
 } // namespace steam
@@ -0,0 +1,246 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/10/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "connector.h"
+
+#include <algorithm>
+
+namespace yeelight
+{
+
+ConnectScheduler::ConnectScheduler(std::shared_ptr<boost::asio::io_context> context, size_t max_concurrent)
+: context(std::move(context)), timer(*this->context), mutex(), entries(), free_entries(),
+  max_concurrent(max_concurrent), random(std::random_device()()), recent_attempts(), totals()
+{
+}
+
+ConnectScheduler::Handle ConnectScheduler::add(std::function<void()> connect)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    Handle handle;
+    if(free_entries.empty())
+    {
+        handle = entries.size();
+        entries.emplace_back();
+    }
+    else
+    {
+        handle = free_entries.back();
+        free_entries.pop_back();
+    }
+
+    entries[handle]         = Entry();
+    entries[handle].active  = true;
+    entries[handle].connect = std::move(connect);
+    return handle;
+}
+
+void ConnectScheduler::remove(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry = entries.at(handle);
+    if(entry.status == Status::connecting) connecting--;
+
+    entry = Entry();
+    free_entries.emplace_back(handle);
+    schedule();
+}
+
+void ConnectScheduler::request(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry = entries.at(handle);
+    if(entry.status != Status::idle and entry.status != Status::connected) return;
+
+    const auto now = clock::now();
+    forgive(entry, now);
+    entry.lost_at = now;
+
+    // the first try after losing a connection does not wait
+    entry.status   = entry.failures == 0 ? Status::ready : Status::backoff;
+    entry.ready_at = now + backoff(entry.failures);
+    schedule();
+}
+
+void ConnectScheduler::release(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry = entries.at(handle);
+    if(entry.status == Status::connecting) connecting--;
+
+    forgive(entry, clock::now());
+    entry.status = Status::idle;
+    schedule();
+}
+
+void ConnectScheduler::finished(Handle handle, bool success)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry = entries.at(handle);
+    if(entry.status != Status::connecting) return;
+
+    connecting--;
+    const auto now = clock::now();
+
+    if(success)
+    {
+        const auto elapsed = now - entry.lost_at;
+        reconnects++;
+
+        totals.last_reconnect = elapsed;
+        totals.average_reconnect += (elapsed - totals.average_reconnect) / static_cast<long>(reconnects);
+
+        // a device that accepts and drops right away would otherwise retry without any backoff
+        entry.status       = Status::connected;
+        entry.connected_at = now;
+    }
+    else
+    {
+        entry.failures++;
+        entry.status   = Status::backoff;
+        entry.ready_at = now + backoff(entry.failures);
+    }
+    schedule();
+}
+
+void ConnectScheduler::lost(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry = entries.at(handle);
+    if(entry.status != Status::connected) return;
+
+    const auto now = clock::now();
+    if(now - entry.connected_at >= stable_time) entry.failures = 0;
+    else
+        entry.failures++;
+}
+
+void ConnectScheduler::reset(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry    = entries.at(handle);
+    entry.failures = 0;
+
+    if(entry.status == Status::backoff)
+    {
+        entry.status   = Status::ready;
+        entry.ready_at = clock::now();
+        schedule();
+    }
+}
+
+void ConnectScheduler::set_priority(Handle handle, bool visible)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    entries.at(handle).visible = visible;
+    schedule();
+}
+
+ConnectMetrics ConnectScheduler::metrics() const
+{
+    const auto lock = std::lock_guard(mutex);
+
+    ConnectMetrics result;
+    result.attempts          = totals.attempts;
+    result.last_reconnect    = totals.last_reconnect;
+    result.average_reconnect = totals.average_reconnect;
+
+    const auto since = clock::now() - rate_window;
+    const auto count = std::count_if(recent_attempts.begin(), recent_attempts.end(),
+                                     [&](const auto& elem) { return elem >= since; });
+    result.attempts_per_second = static_cast<double>(count) / rate_window.count();
+
+    for(const auto& entry : entries)
+    {
+        if(not entry.active) continue;
+
+        switch(entry.status)
+        {
+        case Status::idle: result.idle++; break;
+        case Status::backoff: result.backoff++; break;
+        case Status::ready: result.ready++; break;
+        case Status::connecting: result.connecting++; break;
+        case Status::connected: result.connected++; break;
+        }
+    }
+    return result;
+}
+
+void ConnectScheduler::schedule()
+{
+    const auto now = clock::now();
+
+    // everything of which the backoff ran out is ready to go
+    auto next_wake = clock::time_point::max();
+    for(auto& entry : entries)
+    {
+        if(entry.status != Status::backoff) continue;
+
+        if(entry.ready_at <= now) entry.status = Status::ready;
+        else next_wake = std::min(next_wake, entry.ready_at);
+    }
+
+    // visible devices first, then the ones that waited the longest
+    while(connecting < max_concurrent)
+    {
+        const auto before = [](const Entry& lhs, const Entry& rhs) {
+            if(lhs.status != Status::ready) return false;
+            if(rhs.status != Status::ready) return true;
+            if(lhs.visible != rhs.visible) return lhs.visible;
+            return lhs.ready_at < rhs.ready_at;
+        };
+
+        const auto iter = std::min_element(entries.begin(), entries.end(), before);
+        if(iter == entries.end() or iter->status != Status::ready) break;
+
+        iter->status = Status::connecting;
+        connecting++;
+
+        totals.attempts++;
+        recent_attempts.emplace_back(now);
+        while(recent_attempts.front() < now - rate_window) recent_attempts.pop_front();
+
+        iter->connect();
+    }
+
+    if(next_wake == clock::time_point::max()) return;
+
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(next_wake - now);
+    timer.expires_from_now(boost::posix_time::milliseconds(wait.count() + 1));
+    timer.async_wait([this](auto error) {
+        if(error) return;
+
+        const auto lock = std::lock_guard(mutex);
+        schedule();
+    });
+}
+
+void ConnectScheduler::forgive(Entry& entry, clock::time_point now)
+{
+    if(entry.status == Status::connected and now - entry.connected_at >= stable_time) entry.failures = 0;
+}
+
+ConnectScheduler::clock::duration ConnectScheduler::backoff(size_t failures)
+{
+    if(failures == 0) return {};
+
+    // doubles with every failure up to the cap, jittered between half and all of it
+    const auto exponent = std::min<size_t>(failures - 1, 16);
+    const auto delay    = std::min<clock::duration>(base_delay * (1 << exponent), max_delay);
+
+    std::uniform_int_distribution<clock::rep> distribution(delay.count() / 2, delay.count());
+    return clock::duration(distribution(random));
+}
+
+} // namespace yeelight
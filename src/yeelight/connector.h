@@ -0,0 +1,140 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/10/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace yeelight
+{
+
+struct ConnectMetrics
+{
+    using duration = std::chrono::steady_clock::duration;
+
+    uint64_t attempts            = 0;
+    double   attempts_per_second = 0; // over the last few seconds
+
+    duration last_reconnect    = {}; // from losing the connection to having it back
+    duration average_reconnect = {};
+
+    // how many devices are in each state right now
+    size_t idle       = 0;
+    size_t backoff    = 0;
+    size_t ready      = 0;
+    size_t connecting = 0;
+    size_t connected  = 0;
+};
+
+// Decides when devices may try to connect. A device that keeps failing waits
+// exponentially longer (with jitter so they do not all retry together), only a
+// few connects run at the same time and visible devices get to go first.
+// It can be used from any thread, the connect callbacks are called with the
+// lock held, so they should only post the actual work.
+class ConnectScheduler
+{
+    public:
+    using Handle = size_t;
+    using clock  = std::chrono::steady_clock;
+
+    explicit ConnectScheduler(std::shared_ptr<boost::asio::io_context> context,
+                              size_t max_concurrent = default_concurrent);
+
+    ConnectScheduler(const ConnectScheduler&) = delete;
+
+    ConnectScheduler operator=(const ConnectScheduler&) = delete;
+
+    // the callback starts the actual connect, it has to report back with finished()
+    Handle add(std::function<void()> connect);
+
+    void remove(Handle handle);
+
+    // the device is disconnected and wants to connect again
+    void request(Handle handle);
+
+    // the device does not need a connection anymore, a connect that is still running is forgotten
+    void release(Handle handle);
+
+    // a connect that succeeded keeps its failures until the connection proves stable
+    void finished(Handle handle, bool success);
+
+    // the connection broke, it counts as another failure unless it stayed up for a while
+    void lost(Handle handle);
+
+    // forget the backoff, for when we know the device is back
+    void reset(Handle handle);
+
+    void set_priority(Handle handle, bool visible);
+
+    [[nodiscard]] ConnectMetrics metrics() const;
+
+    private:
+    enum class Status
+    {
+        idle,
+        backoff,
+        ready,
+        connecting,
+        connected,
+    };
+
+    struct Entry
+    {
+        Status status  = Status::idle;
+        bool   visible = false;
+        bool   active  = false;
+
+        size_t            failures = 0;
+        clock::time_point ready_at;
+        clock::time_point lost_at;      // when it started wanting a connection
+        clock::time_point connected_at; // when the last connect succeeded
+
+        std::function<void()> connect;
+    };
+
+    // these expect the lock to be held
+    void schedule();
+
+    clock::duration backoff(size_t failures);
+
+    // forgets the failures if the connection stayed up for long enough
+    void forgive(Entry& entry, clock::time_point now);
+
+    std::shared_ptr<boost::asio::io_context> context;
+    boost::asio::deadline_timer              timer;
+
+    mutable std::mutex mutex;
+
+    std::vector<Entry>  entries;
+    std::vector<Handle> free_entries;
+
+    size_t max_concurrent;
+    size_t connecting = 0;
+
+    std::minstd_rand random;
+
+    // for the metrics
+    std::deque<clock::time_point> recent_attempts;
+    ConnectMetrics                totals;
+    size_t                        reconnects = 0;
+
+    constexpr static size_t default_concurrent = 8;
+    constexpr static auto   base_delay         = std::chrono::milliseconds(500);
+    constexpr static auto   max_delay          = std::chrono::seconds(60);
+    constexpr static auto   rate_window        = std::chrono::seconds(10);
+    constexpr static auto   stable_time        = std::chrono::seconds(10);
+};
+
+} // namespace yeelight
@@ -8,174 +8,399 @@
 //============================================================================
 
 #include "device.h"
-
-#include <boost-icmp/icmp_header.hpp>
-#include <boost-icmp/ipv4_header.hpp>
+#include "flow.h"
+#include "schema.h"
 
 #include <algorithm>
 #include <iostream>
 #include <thread>
 
-#include <boost-icmp/icmp_header.hpp>
 #include <nlohmann/json.h>
 
-namespace
-{
-std::string string_powered(std::chrono::milliseconds duration)
-{
-    return duration > std::chrono::milliseconds(30) ? "smooth" : "sudden";
-}
-
-} // namespace
-
 namespace yeelight
 {
 
 using namespace std::chrono_literals;
 
 Device::Device(const std::shared_ptr<boost::asio::io_context>& context,
-               boost::asio::ip::tcp::endpoint                  endpoint)
-: context(context), tcp_endpoint(std::move(endpoint)), tcp_socket(*context),
-  icmp_endpoint(boost::asio::ip::make_address("10.1.1.10"), 1),
-  icmp_socket(*context, boost::asio::ip::icmp::v4()), buffer(1024, '\0'),
-  state(State::disconnected), pending_requests(), message_id(1), ping_id(1),
-  update_callback(nullptr), error_callback(nullptr), operation_timer(*context),
-  ping_timer(*context)
+               boost::asio::ip::tcp::endpoint                  endpoint,
+               std::shared_ptr<PingService>                    pinger,
+               std::shared_ptr<ConnectScheduler>               connector,
+               std::shared_ptr<MusicServer>                    music,
+               DeviceState                                     initial_state,
+               std::chrono::milliseconds                       idle_timeout)
+: context(context), strand(boost::asio::make_strand(*context)), tcp_endpoint(std::move(endpoint)),
+  tcp_socket(strand), pinger(std::move(pinger)), ping_handle(), on_liveness(), connector(std::move(connector)),
+  connect_handle(), music(std::move(music)), music_handle(), music_requested(false), music_active(false), reader(), state(State::idle), subscribed(false), queue(), pending_requests(), message_id(1),
+  update_callback(nullptr), error_callback(nullptr), state_callback(nullptr), state_mutex(),
+  device_state(std::move(initial_state)), known(), fetched_at(), connected_at(), operation_timer(strand), queue_timer(strand), connect_timer(strand),
+  idle_timeout(idle_timeout), idle_timer(strand)
 {
     // TODO: something something capabilities
-    // for some reason the ICMP socket has to connect...
-    // icmp_socket.connect(icmp_endpoint);
 
-    // try to establish a connection
-    try_connecting();
+    // a device that stops answering pings is gone, even if tcp did not notice yet
+    const auto liveness_handler = [this](bool up) {
+        if(not up and state == State::connected)
+        {
+            reconnect();
+        }
+        else if(up and state == State::disconnected)
+        {
+            // it is back, so there is no reason to wait out the backoff
+            this->connector->reset(connect_handle);
+        }
+    };
+
+    // the shared services call back from their own threads, so hop onto our strand
+    on_liveness = [this, liveness_handler](bool up) {
+        boost::asio::post(strand, std::bind(liveness_handler, up));
+    };
+    const auto on_connect = [this]() { boost::asio::post(strand, [this]() { connect(); }); };
+
+    ping_handle    = this->pinger->subscribe(tcp_endpoint.address().to_v4(), on_liveness);
+    connect_handle = this->connector->add(on_connect);
+
+    // nothing connects until there is something to send or someone subscribes
+}
+
+Device::~Device()
+{
+    pinger->unsubscribe(ping_handle);
+    connector->remove(connect_handle);
+    if(music_requested) music->remove(music_handle);
 }
 
 void Device::set_update_callback(std::function<void(Parameter, Value)> callback)
 {
-    update_callback = std::move(callback);
+    boost::asio::post(strand, [this, callback = std::move(callback)]() {
+        update_callback = callback;
+
+        // we might have connected before anyone was listening
+        if(state == State::connected and update_callback != nullptr) update_callback(Parameter::connected, 1);
+    });
 }
 
 void Device::set_error_callback(std::function<void(Error)> callback)
 {
-    error_callback = std::move(callback);
+    boost::asio::post(strand, [this, callback = std::move(callback)]() { error_callback = callback; });
 }
 
 
-void Device::toggle()
+void Device::set_state_callback(std::function<void(const DeviceState&)> callback)
 {
-    send_operation("toggle");
+    boost::asio::post(strand, [this, callback = std::move(callback)]() { state_callback = callback; });
 }
 
-void Device::set_color_temperature(size_t temp, std::chrono::milliseconds duration)
+DeviceState Device::current_state() const
 {
-    send_operation("set_ct_abx", temp, string_powered(duration), duration.count());
+    const auto lock = std::lock_guard(state_mutex);
+    return device_state;
 }
 
-void Device::set_rgb_color(dot::color color, std::chrono::milliseconds duration)
+void Device::update_state(DeviceState state)
 {
-    send_operation("set_rgb", dot::color::to_rgb(color),
-                   string_powered(duration), duration.count());
+    boost::asio::post(strand, [this, state = std::move(state)]() {
+        {
+            const auto lock = std::lock_guard(state_mutex);
+            device_state    = state;
+        }
+        if(state_callback != nullptr) state_callback(state);
+    });
 }
 
-void Device::set_brightness(size_t brightness, std::chrono::milliseconds duration)
+void Device::merge_advertisement(const Advertisement& advertisement)
 {
-    send_operation("set_bright", brightness, string_powered(duration), duration.count());
+    // only the name is a view that update_state reads, the receive buffer is reused once we return
+    auto copy     = advertisement;
+    copy.model    = {};
+    copy.firmware = {};
+    copy.support  = {};
+
+    auto       name     = std::string(advertisement.name);
+    const auto endpoint = boost::asio::ip::tcp::endpoint(advertisement.address, advertisement.port);
+
+    boost::asio::post(strand, [this, copy, name = std::move(name), endpoint]() mutable {
+        copy.name = name;
+        if(endpoint != tcp_endpoint) move_to(endpoint);
+
+        // merged here, so a notification that came in meanwhile is not overwritten with older values
+        DeviceState state;
+        {
+            const auto lock = std::lock_guard(state_mutex);
+            yeelight::update_state(device_state, copy);
+            state = device_state;
+        }
+        if(state_callback != nullptr) state_callback(state);
+    });
 }
 
-void Device::set_powered(bool on, std::chrono::milliseconds duration)
+void Device::get_properties(PropertySet properties, PropertiesCallback callback, std::chrono::milliseconds max_age)
 {
-    send_operation("set_power", on ? "on" : "off", string_powered(duration),
+    boost::asio::post(strand, [this, properties, callback = std::move(callback), max_age]() {
+        auto missing = properties;
+        for(size_t i = 0; i < missing.size(); i++)
+        {
+            if(missing.test(i) and is_fresh(static_cast<Property>(i), max_age)) missing.reset(i);
+        }
+
+        if(missing.none())
+        {
+            if(callback != nullptr) callback(Error::none, current_state());
+            return;
+        }
+
+        const auto handler = [this, missing, callback](const Response& response) {
+            handle_properties(missing, response, callback);
+        };
+        enqueue(make_command(method::get_prop, handler, missing));
+    });
+}
+
+void Device::toggle(ResponseCallback callback)
+{
+    send_operation(std::move(callback), method::toggle);
+}
+
+void Device::set_color_temperature(size_t temp, std::chrono::milliseconds duration, ResponseCallback callback)
+{
+    send_operation(std::move(callback), method::set_ct_abx, temp, string_powered(duration),
                    duration.count());
 }
 
-void Device::start_color_flow(flow_stop_action action, const std::vector<flow_state>& states)
+void Device::set_rgb_color(dot::color color, std::chrono::milliseconds duration, ResponseCallback callback)
 {
-    std::stringstream stream;
-    for(const auto& state : states)
-    {
-        stream << state.duration.count() << ',';
-        stream << static_cast<size_t>(state.mode) << ',';
-
-        if(state.mode == color_mode::temperature)
-            stream << state.temperature << ',';
-        else if(state.mode == color_mode::rgb)
-            stream << dot::color::to_rgb(state.color) << ',';
-        else if(state.mode == color_mode::sleep)
-            stream << 0 << ',';
-        else
-            throw std::logic_error("cannot put color flow in hsv mode");
+    send_operation(std::move(callback), method::set_rgb, dot::color::to_rgb(color),
+                   string_powered(duration), duration.count());
+}
 
-        stream << state.brightness;
-    }
+void Device::set_brightness(size_t brightness, std::chrono::milliseconds duration, ResponseCallback callback)
+{
+    send_operation(std::move(callback), method::set_bright, brightness,
+                   string_powered(duration), duration.count());
+}
 
-    send_operation("start_cf", states.size(), static_cast<size_t>(action),
-                   stream.str());
+void Device::set_powered(bool on, std::chrono::milliseconds duration, ResponseCallback callback)
+{
+    send_operation(std::move(callback), method::set_power, on ? "on" : "off",
+                   string_powered(duration), duration.count());
+}
+
+void Device::start_color_flow(flow_stop_action               action,
+                              const std::vector<flow_state>& states,
+                              ResponseCallback               callback)
+{
+    start_color_flow(CompiledFlow(action, states), std::move(callback));
 }
 
-void Device::stop_color_flow()
+void Device::start_color_flow(const CompiledFlow& flow, ResponseCallback callback)
 {
-    send_operation("stop_cf");
+    boost::asio::post(strand, [this, command = flow.command(std::move(callback))]() mutable {
+        enqueue(std::move(command));
+    });
 }
 
-void Device::set_shutdown_timer(std::chrono::minutes time)
+void Device::stop_color_flow(ResponseCallback callback)
 {
-    send_operation("cron_add", 0, time.count());
+    send_operation(std::move(callback), method::stop_cf);
 }
 
-void Device::remove_shutdown_timer()
+void Device::set_shutdown_timer(std::chrono::minutes time, ResponseCallback callback)
 {
-    send_operation("cron_del", 0);
+    send_operation(std::move(callback), method::cron_add, 0, time.count());
 }
 
-void Device::set_name(std::string name)
+void Device::remove_shutdown_timer(ResponseCallback callback)
 {
-    send_operation("set_name", std::move(name));
+    send_operation(std::move(callback), method::cron_del, 0);
 }
 
-template <typename... Args>
-void Device::send_operation(std::string method, Args... args)
+void Device::set_name(std::string name, ResponseCallback callback)
 {
-    const auto current_id      = message_id;
-    const auto timeout_handler = [this, current_id](auto error) {
-        if(not handle_wait_error(error, "send timeout")) return;
+    send_operation(std::move(callback), method::set_name, name);
+}
+
+template <typename... Params, typename... Args>
+void Device::send_operation(ResponseCallback callback, const Method<Params...>& method, Args&&... args)
+{
+    // serializing is done by the caller, everything else happens on our strand
+    auto command = make_command(method, std::move(callback), std::forward<Args>(args)...);
+    boost::asio::post(strand, [this, command = std::move(command)]() mutable {
+        enqueue(std::move(command));
+    });
+}
 
-        if(pending_requests.find(current_id) != pending_requests.end())
+void Device::enqueue(Command command)
+{
+    // setters skip the queue in music mode, the server only keeps the newest one
+    if(music_active and command.coalesce)
+    {
+        if(command.callback != nullptr)
         {
-            // this means no response was found after x seconds,
-            // so we assume the lamp was disconnected of for some reason
-            state = State::disconnected;
-            update_callback(Parameter::connected, 0);
-            try_connecting();
+            command.callback = [this, callback = std::move(command.callback)](const Response& response) {
+                boost::asio::post(strand, std::bind(callback, response));
+            };
         }
-    };
+        music->push(music_handle, std::move(command));
+        return;
+    }
+
+    auto replaced = queue.push(std::move(command));
+    if(replaced and replaced->callback != nullptr)
+    {
+        replaced->callback(Response{ 0, Error::superseded, nullptr, {} });
+    }
 
-    const auto send_handler
-    = [this](auto error, auto) { handle_tcp_error(error, "send request"); };
+    // the queue is flushed once we are connected
+    if(state != State::connected) want_connection();
+    else flush_queue();
+}
 
-    // if connected send the request
-    if(state == State::connected)
+void Device::dispatch(std::vector<Command> commands, WriteHandler handler)
+{
+    boost::asio::post(strand, [this, commands = std::move(commands), handler = std::move(handler)]() mutable {
+        dispatch_now(std::move(commands), std::move(handler));
+    });
+}
+
+void Device::dispatch_now(std::vector<Command> commands, WriteHandler handler)
+{
+    // nothing would ever be written, so the handler would never hear back
+    if(commands.empty())
+    {
+        if(handler != nullptr) handler(boost::system::error_code());
+        return;
+    }
+
+    if(state != State::connected)
     {
-        auto json      = nlohmann::json();
-        json["id"]     = message_id++;
-        json["method"] = std::move(method);
-        (json["params"].emplace_back(std::move(args)), ...);
+        deferred.emplace_back(std::move(commands), std::move(handler));
+        want_connection();
+        return;
+    }
 
-        tcp_socket.async_send(boost::asio::buffer(json.dump() + "\r\n"), send_handler);
+    // these replace whatever was still waiting for a token
+    for(auto& command : commands)
+    {
+        queue.consume();
 
-        operation_timer.expires_from_now(boost::posix_time::milliseconds(operation_timeout));
-        operation_timer.async_wait(timeout_handler);
+        auto replaced = queue.take(command.method);
+        if(replaced and replaced->callback != nullptr)
+        {
+            replaced->callback(Response{ 0, Error::superseded, nullptr, {} });
+        }
     }
-    else
+
+    write(std::move(commands), std::move(handler));
+}
+
+void Device::flush_queue()
+{
+    std::vector<Command> commands;
+    while(state == State::connected)
     {
-        error_callback(Error::not_connected);
+        auto command = queue.pop();
+        if(not command) break;
+
+        commands.emplace_back(std::move(*command));
     }
+
+    if(not commands.empty()) write(std::move(commands));
+    if(state != State::connected or queue.empty()) return;
+
+    // wait for the bucket to hand out the next token
+    const auto handler = [this](auto error) {
+        if(error == boost::asio::error::operation_aborted) return;
+        if(handle_wait_error(error, "queue timer")) flush_queue();
+    };
+
+    const auto wait = queue.next_token() - CommandQueue::clock::now();
+    const auto ms   = std::chrono::duration_cast<std::chrono::milliseconds>(wait).count() + 1;
+
+    queue_timer.expires_from_now(boost::posix_time::milliseconds(ms));
+    queue_timer.async_wait(handler);
 }
 
+void Device::write(std::vector<Command> commands, WriteHandler handler)
+{
+    const auto was_empty = pending_requests.empty();
+
+    for(auto& command : commands)
+    {
+        const auto current_id = message_id++;
+
+        // the frames go straight into the outbox, which keeps its capacity between writes
+        append_frame(outbox, current_id, command);
+
+        pending_requests.insert(current_id, std::chrono::milliseconds(operation_timeout),
+                                std::move(command.callback));
+    }
+    if(handler != nullptr) outbox_handlers.emplace_back(std::move(handler));
 
-void Device::start_listening()
+    if(was_empty and not pending_requests.empty()) reset_operation_timer();
+    if(not writing) start_writing();
+    reset_idle_timer();
+}
+
+void Device::start_writing()
+{
+    if(outbox.empty()) return;
+
+    // only one write can be in progress on a socket, everything that was
+    // queued in the meantime goes out together in the next one
+    writing = spare != nullptr ? std::move(spare) : std::make_shared<Outgoing>();
+    writing->data.swap(outbox);
+    writing->handlers.swap(outbox_handlers);
+
+    const auto handler = [this, outgoing = writing](auto error, auto) {
+        for(const auto& elem : outgoing->handlers) elem(error);
+
+        // a disconnect in the meantime already started over
+        if(writing != outgoing) return;
+        writing = nullptr;
+
+        // the buffers are used again for the write after the next
+        outgoing->data.clear();
+        outgoing->handlers.clear();
+        spare = outgoing;
+
+        if(not handle_tcp_error(error, "send request")) return;
+        start_writing();
+    };
+
+    boost::asio::async_write(tcp_socket, boost::asio::buffer(writing->data), handler);
+}
+
+QueueStatistics Device::queue_statistics() const
 {
-    start_tcp_listening();
-    start_icmp_listening();
+    return queue.statistics();
+}
+
+Liveness Device::liveness() const
+{
+    return pinger->liveness(ping_handle);
+}
+
+void Device::reset_operation_timer()
+{
+    // one tick checks the deadlines of every request in flight,
+    // it only keeps running as long as there is something to check
+    const auto tick_handler = [this](auto error) {
+        if(error == boost::asio::error::operation_aborted) return;
+        if(not handle_wait_error(error, "operation tick")) return;
+
+        if(pending_requests.expire() != 0)
+        {
+            // this means no response was found in time,
+            // so we assume the lamp was disconnected of for some reason
+            reconnect();
+            return;
+        }
+
+        if(not pending_requests.empty()) reset_operation_timer();
+    };
+
+    operation_timer.expires_from_now(boost::posix_time::milliseconds(operation_tick));
+    operation_timer.async_wait(tick_handler);
 }
 
 void Device::start_tcp_listening()
@@ -184,51 +409,169 @@ void Device::start_tcp_listening()
         // TODO; repair state
         if(not handle_tcp_error(error, "tcp receive")) return;
 
-        const auto json = nlohmann::json::parse(buffer.substr(0, bytes));
-
-        if(json.contains("id"))
+        reader.commit(bytes);
+        while(const auto line = reader.next())
         {
-            const uint64_t id = json["id"];
-            pending_requests.erase(id);
-        }
-        else
-        {
-            std::cout << json << '\n';
+            handle_message(*line);
         }
 
-        reset_ping_timer();
-        start_listening();
+        start_tcp_listening();
     };
 
     // start the receive loop
-    tcp_socket.async_receive(boost::asio::buffer(buffer), tcp_receive);
+    tcp_socket.async_receive(reader.prepare(), tcp_receive);
+}
+
+void Device::handle_message(std::string_view message)
+{
+    // the bulb telling us what changed is by far the most common message
+    if(const auto change = parse_notification(message))
+    {
+        handle_notification(*change);
+        return;
+    }
+
+    // parse straight from the receive buffer, a broken line should not take the rest down
+    const auto json = nlohmann::json::parse(message.begin(), message.end(), nullptr, false);
+    if(json.is_discarded())
+    {
+        std::cout << "received malformed message: " << message << '\n';
+        return;
+    }
+
+    const auto id = json.find("id");
+    if(id != json.end() and id->is_number_unsigned())
+    {
+        const auto result = json.find("result");
+        if(result != json.end())
+            pending_requests.complete(*id, Error::none, std::move(*result));
+        else
+            pending_requests.complete(*id, Error::rejected, json.value("error", nlohmann::json()));
+    }
+    else
+    {
+        std::cout << json << '\n';
+    }
+}
+
+void Device::handle_notification(const PropertyChange& change)
+{
+    DeviceState previous;
+    DeviceState current;
+    {
+        const auto lock = std::lock_guard(state_mutex);
+        previous        = device_state;
+        apply_change(device_state, change);
+        current = device_state;
+    }
+    mark_fresh(present(change));
+
+    if(update_callback != nullptr)
+    {
+        const auto color = [](const DeviceState& state) {
+            return state.mode == color_mode::temperature ? static_cast<Value>(state.temperature) : state.rgb;
+        };
+
+        if(current.powered != previous.powered) update_callback(Parameter::powered, current.powered);
+        if(current.brightness != previous.brightness)
+            update_callback(Parameter::brightness, static_cast<Value>(current.brightness));
+        if(color(current) != color(previous)) update_callback(Parameter::color, color(current));
+        if(current.flowing != previous.flowing) update_callback(Parameter::flowing, current.flowing);
+    }
+
+    // one call for the whole notification, so a view redraws once
+    if(state_callback != nullptr) state_callback(current);
 }
 
-void Device::start_icmp_listening()
+void Device::handle_properties(PropertySet requested, const Response& response, const PropertiesCallback& callback)
 {
-    const auto ping_receive = [this](auto error, auto) {
-        // TODO: maybe also check want went wrong and such
-        if(not handle_icmp_error(error, "icmp receive")) return;
+    // the values come back as strings, in the order we asked for them
+    const auto& result = response.result;
+    if(response.error != Error::none or not result.is_array() or result.size() != requested.count())
+    {
+        const auto error = response.error != Error::none ? response.error : Error::rejected;
+        if(callback != nullptr) callback(error, current_state());
+        return;
+    }
 
-        icmp_header icmp_header;
-        ipv4_header ipv4_header;
-        std::string body;
+    PropertyChange change;
+    std::optional<std::string> name; // already unescaped by the json parser
 
-        // this is awful, this will print data from the previous
-        // request because the buffer is initialized with zeroes
-        // TODO: something something bytes received smart stuff
-        std::istringstream(buffer) >> ipv4_header >> icmp_header >> body;
-        std::cout << "received ping: " << body << '\n';
-        if(icmp_header.identifier() == 93 and icmp_header.sequence_number() == ping_id)
-        {
-            ping_id++;
-        }
+    size_t index = 0;
+    for(size_t i = 0; i < requested.size(); i++)
+    {
+        if(not requested.test(i)) continue;
+
+        const auto& value = result[index++];
+        if(not value.is_string()) continue;
 
-        start_icmp_listening();
+        const auto& text = value.get_ref<const std::string&>();
+        if(static_cast<Property>(i) == Property::name) name = text;
+        else set_property(change, static_cast<Property>(i), text);
+    }
+
+    // a value that was not a string or did not parse is as unknown as before, ask again next time
+    auto decoded = present(change);
+    decoded.set(static_cast<size_t>(Property::name), name.has_value());
+
+    DeviceState current;
+    {
+        const auto lock = std::lock_guard(state_mutex);
+        apply_change(device_state, change);
+        if(name) device_state.name = std::move(*name);
+        current = device_state;
+    }
+    mark_fresh(decoded);
+
+    if(state_callback != nullptr) state_callback(current);
+    if(callback != nullptr) callback(Error::none, current);
+}
+
+bool Device::is_fresh(Property property, std::chrono::milliseconds max_age) const
+{
+    const auto index = static_cast<size_t>(property);
+    if(not known.test(index)) return false;
+
+    // while connected every change is notified, so what we read since then is still right
+    const auto read_at = fetched_at[index];
+    if(state == State::connected and read_at >= connected_at) return true;
+
+    return std::chrono::steady_clock::now() - read_at <= max_age;
+}
+
+void Device::mark_fresh(PropertySet properties)
+{
+    const auto now = std::chrono::steady_clock::now();
+    for(size_t i = 0; i < properties.size(); i++)
+    {
+        if(properties.test(i)) fetched_at[i] = now;
+    }
+    known |= properties;
+}
+
+void Device::want_connection()
+{
+    if(state == State::connected) return;
+
+    if(state == State::idle) try_connecting();
+
+    // the connector might keep us waiting, but not forever. The deadline counts from the
+    // first command that waits, later ones do not push it back
+    if(connect_waiting) return;
+    connect_waiting = true;
+
+    const auto handler = [this](auto error) {
+        if(error == boost::asio::error::operation_aborted) return;
+        connect_waiting = false;
+
+        if(state == State::connected or not handle_wait_error(error, "connect timer")) return;
+
+        fail_waiting();
+        if(not subscribed) go_idle();
     };
 
-    // start the receive loop
-    icmp_socket.async_receive(boost::asio::buffer(buffer), ping_receive);
+    connect_timer.expires_from_now(boost::posix_time::milliseconds(connect_timeout));
+    connect_timer.async_wait(handler);
 }
 
 void Device::try_connecting()
@@ -238,116 +581,247 @@ void Device::try_connecting()
         throw std::logic_error("already connected");
     }
 
-    const auto handler = [this](auto error) {
-        if(error == boost::asio::error::connection_aborted
-           or error == boost::asio::error::host_unreachable)
-        {
-            state = State::disconnected;
-            update_callback(Parameter::connected, 0);
-            try_connecting();
-        }
-        else if(error == boost::asio::error::connection_refused)
-        {
-            std::cout << "TODO: handle connection refused\n";
-            state = State::disconnected;
-            update_callback(Parameter::connected, 0);
-            try_connecting();
-        }
-        else if(handle_tcp_error(error, "connecting tcp"))
+    // the scheduler calls connect() when it is our turn
+    state = State::disconnected;
+    connector->request(connect_handle);
+}
+
+void Device::connect()
+{
+    // we stopped wanting the connection while waiting for our turn, give the slot back
+    if(state != State::disconnected)
+    {
+        connector->release(connect_handle);
+        return;
+    }
+
+    // whoever gave up on this attempt closed the socket already, and the
+    // socket may well belong to the next attempt by the time we hear of it
+    const auto attempt = ++connect_attempt;
+    const auto handler = [this, attempt](auto error) {
+        if(error == boost::asio::error::operation_aborted or attempt != connect_attempt) return;
+
+        if(error)
         {
-            state = State::connected;
-            update_callback(Parameter::connected, 1);
-            reset_ping_timer();
+            // the scheduler retries with a backoff, nothing else to do here
+            boost::system::error_code ignored;
+            tcp_socket.close(ignored);
+            connector->finished(connect_handle, false);
+            return;
         }
+
+        connector->finished(connect_handle, true);
+
+        state           = State::connected;
+        connected_at    = std::chrono::steady_clock::now();
+        connect_waiting = false;
+        connect_timer.cancel();
+        if(update_callback != nullptr) update_callback(Parameter::connected, 1);
+        start_tcp_listening();
+
+        // send everything that waited for us
+        for(auto& [commands, handler] : std::exchange(deferred, {})) dispatch_now(std::move(commands), std::move(handler));
+        flush_queue();
+        reset_idle_timer();
     };
 
     boost::system::error_code            error;
     boost::asio::socket_base::keep_alive option(true);
 
+    // whatever was half received on the previous connection is useless now
+    reader.clear();
+
     tcp_socket.open(tcp_endpoint.protocol(), error);
-    tcp_socket.set_option(option);
+    tcp_socket.set_option(option, error);
 
     tcp_socket.async_connect(tcp_endpoint, handler);
 }
 
-void Device::reset_ping_timer()
+void Device::move_to(const boost::asio::ip::tcp::endpoint& endpoint)
 {
-    const std::function<void(boost::system::error_code)> timeout_handler = [this](auto error) {
-        if(not handle_wait_error(error, "ping timeout")) return;
-        // this means disconnect usually
+    std::cout << "device moved from " << tcp_endpoint << " to " << endpoint << '\n';
+    const auto moved_host = endpoint.address() != tcp_endpoint.address();
+    tcp_endpoint          = endpoint;
 
-        send_ping();
-        reset_ping_timer();
-    };
+    if(moved_host)
+    {
+        // pings are matched on the address, and so is the connection back in music mode
+        pinger->unsubscribe(ping_handle);
+        ping_handle = pinger->subscribe(tcp_endpoint.address().to_v4(), on_liveness);
+
+        if(music_requested)
+        {
+            music_requested = false;
+            music_active    = false;
+            music->remove(music_handle);
+        }
+    }
 
-    ping_timer.cancel();
-    ping_timer.expires_from_now(boost::posix_time::milliseconds(ping_timeout));
-    ping_timer.async_wait(timeout_handler);
+    // whatever is open goes to the old address, the next connect uses the new one
+    if(state != State::idle) reconnect();
 }
 
-void Device::send_ping()
+void Device::set_visible(bool visible)
 {
-    // TODO: do bigbrain stuff without having to reconstructing the string every time
-    std::string body("Silky");
+    connector->set_priority(connect_handle, visible);
+}
 
-    // Create an ICMP header for an echo request.
-    icmp_header echo_request;
-    echo_request.type(icmp_header::echo_request);
-    echo_request.code(0); // must be 0
-    echo_request.identifier(93);
-    echo_request.sequence_number(ping_id);
-    compute_checksum(echo_request, body.begin(), body.end());
+void Device::set_music(bool enabled, ResponseCallback callback)
+{
+    boost::asio::post(strand, [this, enabled, callback = std::move(callback)]() mutable {
+        if(enabled == music_requested)
+        {
+            if(callback != nullptr) callback(Response{ 0, Error::none, nullptr, {} });
+            return;
+        }
 
-    // Encode the request packet.
-    boost::asio::streambuf request_buffer;
-    std::ostream           os(&request_buffer);
-    os << echo_request << body;
+        music_requested = enabled;
+        music_active    = false;
 
-    const auto send_handler = [this](auto error, auto) {
-        handle_icmp_error(error, "send ping");
-        std::cout << "sending ping\n";
-    };
+        // closing the connection is all it takes to leave music mode
+        if(not enabled)
+        {
+            music->remove(music_handle);
+            if(callback != nullptr) callback(Response{ 0, Error::none, nullptr, {} });
+            return;
+        }
 
-    // Send the request.
-    icmp_socket.async_send_to(request_buffer.data(), icmp_endpoint, send_handler);
+        const auto listener = [this](bool connected) {
+            boost::asio::post(strand, [this, connected]() {
+                if(not music_requested) return;
+
+                music_active = connected;
+                if(connected) return;
+
+                music_requested = false;
+                music->remove(music_handle);
+            });
+        };
+        music_handle = music->add(tcp_endpoint.address().to_v4(), listener);
+
+        // a bulb that refuses will never connect, so stop waiting for it
+        const auto handler = [this, callback = std::move(callback)](const Response& response) {
+            if(response.error != Error::none and music_requested)
+            {
+                music_requested = false;
+                music->remove(music_handle);
+            }
+            if(callback != nullptr) callback(response);
+        };
+
+        const auto host = music->local_address(tcp_endpoint.address().to_v4()).to_string();
+        enqueue(make_command(method::set_music, handler, 1, host, music->port()));
+    });
 }
 
-bool Device::handle_tcp_error(boost::system::error_code error, std::string info)
+void Device::set_subscribed(bool subscribed)
 {
-    if(error == boost::asio::error::connection_reset or error == boost::asio::error::eof)
-    {
-        std::cout << "tcp error: " << error << ". trying to reconnect\n";
+    boost::asio::post(strand, [this, subscribed]() {
+        this->subscribed = subscribed;
 
-        state = State::disconnected;
-        update_callback(Parameter::connected, 0);
+        if(subscribed and state == State::idle) try_connecting();
+        else if(not subscribed and state == State::connected) reset_idle_timer();
+    });
+}
 
-        try_connecting();
-        return false;
-    }
-    else if(error)
-    {
-        throw std::runtime_error("tcp error: " + std::to_string(error.value())
-                                 + " " + std::move(info));
-    }
-    else
-    {
-        return true;
-    }
+void Device::disconnect()
+{
+    boost::system::error_code error;
+    tcp_socket.close(error);
+    operation_timer.cancel();
+    queue_timer.cancel();
+    idle_timer.cancel();
+
+    writing = nullptr;
+    outbox.clear();
+    for(const auto& handler : std::exchange(outbox_handlers, {})) handler(boost::asio::error::not_connected);
+
+    const auto was_connected = state == State::connected;
+    state = State::disconnected;
+
+    // nothing that was in flight will be answered on a new connection
+    pending_requests.fail_all(Error::not_connected);
+    fail_waiting();
+    if(was_connected and update_callback != nullptr) update_callback(Parameter::connected, 0);
+}
+
+void Device::reconnect()
+{
+    if(state == State::connected) connector->lost(connect_handle);
+    disconnect();
+
+    if(subscribed) try_connecting();
+    else go_idle();
+}
+
+void Device::go_idle()
+{
+    boost::system::error_code error;
+    tcp_socket.close(error);
+    connect_waiting = false;
+    connect_timer.cancel();
+
+    connect_attempt++;
+    state = State::idle;
+    connector->release(connect_handle);
 }
 
-bool Device::handle_icmp_error(boost::system::error_code error, std::string info)
+void Device::fail_waiting()
 {
-    if(error)
+    if(queue.empty() and deferred.empty()) return;
+    if(error_callback != nullptr) error_callback(Error::not_connected);
+
+    for(auto& command : queue.clear())
     {
-        throw std::runtime_error("icmp error: " + std::to_string(error.value())
-                                 + " " + std::move(info));
+        if(command.callback != nullptr) command.callback(Response{ 0, Error::not_connected, nullptr, {} });
     }
-    else
+    for(auto& [commands, handler] : std::exchange(deferred, {}))
     {
-        return true;
+        for(auto& command : commands)
+        {
+            if(command.callback != nullptr) command.callback(Response{ 0, Error::not_connected, nullptr, {} });
+        }
+        if(handler != nullptr) handler(boost::asio::error::not_connected);
     }
 }
 
+void Device::reset_idle_timer()
+{
+    // setting the expiry cancels the previous wait, so every write pushes it back
+    const auto handler = [this](auto error) {
+        if(error == boost::asio::error::operation_aborted or state != State::connected) return;
+        if(not handle_wait_error(error, "idle timer")) return;
+
+        const auto busy = writing != nullptr or not pending_requests.empty() or not queue.empty();
+        if(subscribed or busy)
+        {
+            reset_idle_timer();
+            return;
+        }
+
+        disconnect();
+        go_idle();
+    };
+
+    idle_timer.expires_from_now(boost::posix_time::milliseconds(idle_timeout.count()));
+    idle_timer.async_wait(handler);
+}
+
+bool Device::handle_tcp_error(boost::system::error_code error, std::string info)
+{
+    // the socket was closed by disconnect(), which already cleaned up
+    if(error == boost::asio::error::operation_aborted) return false;
+
+    if(not error) return true;
+
+    // an unplugged bulb shows up as a timeout or an unreachable host rather than a reset,
+    // whatever it was, the connector retries with its backoff like any failed connect
+    std::cout << "tcp error: " << error.message() << " (" << info << "). trying to reconnect\n";
+
+    reconnect();
+    return false;
+}
+
 bool Device::handle_wait_error(boost::system::error_code error, std::string info)
 {
     if(error == boost::asio::error::operation_aborted)
@@ -12,16 +12,27 @@
 #include <chrono>
 #include <map>
 #include <memory>
+#include <mutex>
 #include <regex>
 #include <string>
+#include <string_view>
 #include <variant>
 #include <vector>
 
 #include <boost/asio.hpp>
 #include <queue>
-#include <set>
 #include <utility/color.h>
 
+#include "connector.h"
+#include "flow.h"
+#include "music.h"
+#include "notification.h"
+#include "pending.h"
+#include "ping.h"
+#include "queue.h"
+#include "reader.h"
+#include "schema.h"
+#include "ssdp.h"
 #include "util.h"
 
 
@@ -30,8 +41,9 @@ namespace yeelight
 
 enum class State
 {
+    idle,         // nobody needs a connection
+    disconnected, // waiting for the connector to give us a turn
     connected,
-    disconnected,
 };
 
 enum class Parameter
@@ -39,22 +51,31 @@ enum class Parameter
     connected,
     powered,
     brightness,
-    color,
-};
-
-enum class Error
-{
-    none,
-    not_connected
+    color, // the rgb value, or the temperature in temperature mode
+    flowing,
 };
 
 using Value = uint32_t;
 
+using WriteHandler = std::function<void(boost::system::error_code)>;
+
+// the state has every property that was asked for, unless there was an error
+using PropertiesCallback = std::function<void(Error, const DeviceState&)>;
+
+// All public functions can be called from any thread, the work is posted onto
+// the device's strand. Every callback is called from that strand as well.
 class Device
 {
     public:
     Device(const std::shared_ptr<boost::asio::io_context>& context,
-           boost::asio::ip::tcp::endpoint                  endpoint);
+           boost::asio::ip::tcp::endpoint                  endpoint,
+           std::shared_ptr<PingService>                    pinger,
+           std::shared_ptr<ConnectScheduler>               connector,
+           std::shared_ptr<MusicServer>                    music,
+           DeviceState                                     initial_state = DeviceState(),
+           std::chrono::milliseconds                       idle_timeout  = default_idle_timeout);
+
+    ~Device();
 
     Device(const Device&) = delete;
 
@@ -62,86 +83,231 @@ class Device
 
     ////////////////////////////////////////////////////
 
+    // called for every parameter that changed, a notification with several
+    // changes first calls this for each of them and then the state callback once
     void set_update_callback(std::function<void(Parameter, Value)> callback);
 
     void set_error_callback(std::function<void(Error)> callback);
 
+    // called once for every change to the state, with the whole new state
+    void set_state_callback(std::function<void(const DeviceState&)> callback);
+
+    ////////////////////////////////////////////////////
+
+    // the last known state, this is known before we are even connected
+    [[nodiscard]] DeviceState current_state() const;
+
+    // for when someone else learned something new, like a NOTIFY from the bulb
+    void update_state(DeviceState state);
+
+    // merges what the bulb announced into the state it has by then, and follows it
+    // to its new address if it moved. The advertisement is copied, the packet may go.
+    void merge_advertisement(const Advertisement& advertisement);
+
+    // asks the bulb for the properties in a single get_prop, except the ones that are
+    // still fresh: those that were read less than max_age ago, or that were read during
+    // the current connection, on which the bulb notifies us of every change
+    void get_properties(PropertySet               properties,
+                        PropertiesCallback        callback,
+                        std::chrono::milliseconds max_age = default_max_age);
+
     ////////////////////////////////////////////////////
 
-    void toggle();
+    // every command optionally takes a callback which is called exactly once,
+    // with the bulb's result, its error or a timeout
+    void toggle(ResponseCallback callback = nullptr);
 
-    void set_color_temperature(size_t temp, std::chrono::milliseconds duration = default_duration);
+    void set_color_temperature(size_t                    temp,
+                               std::chrono::milliseconds duration = default_duration,
+                               ResponseCallback          callback = nullptr);
 
-    void set_rgb_color(dot::color color, std::chrono::milliseconds duration = default_duration);
+    void set_rgb_color(dot::color                color,
+                       std::chrono::milliseconds duration = default_duration,
+                       ResponseCallback          callback = nullptr);
 
-    void set_brightness(size_t brightness, std::chrono::milliseconds duration = default_duration);
+    void set_brightness(size_t                    brightness,
+                        std::chrono::milliseconds duration = default_duration,
+                        ResponseCallback          callback = nullptr);
 
-    void set_powered(bool on, std::chrono::milliseconds duration = default_duration);
+    void set_powered(bool                      on,
+                     std::chrono::milliseconds duration = default_duration,
+                     ResponseCallback          callback = nullptr);
 
-    void start_color_flow(flow_stop_action action, const std::vector<flow_state>& states);
+    void start_color_flow(flow_stop_action               action,
+                          const std::vector<flow_state>& states,
+                          ResponseCallback               callback = nullptr);
 
-    void stop_color_flow();
+    // a flow that is started often, or on many devices, is best compiled once
+    void start_color_flow(const CompiledFlow& flow, ResponseCallback callback = nullptr);
 
-    void set_shutdown_timer(std::chrono::minutes time);
+    void stop_color_flow(ResponseCallback callback = nullptr);
 
-    void remove_shutdown_timer();
+    void set_shutdown_timer(std::chrono::minutes time, ResponseCallback callback = nullptr);
 
-    void set_name(std::string name);
+    void remove_shutdown_timer(ResponseCallback callback = nullptr);
+
+    void set_name(std::string name, ResponseCallback callback = nullptr);
+
+    ////////////////////////////////////////////////////
+
+    // sends the commands right away in a single write, without waiting for the pacing,
+    // the handler is called once they are handed to the network
+    void dispatch(std::vector<Command> commands, WriteHandler handler = nullptr);
+
+    // snapshots, these can be read from any thread
+    [[nodiscard]] QueueStatistics queue_statistics() const;
+
+    [[nodiscard]] Liveness liveness() const;
+
+    // visible devices get to reconnect first
+    void set_visible(bool visible);
+
+    // in music mode the bulb connects to our music server, every setter then goes
+    // over that connection once a tick instead of being paced by the queue,
+    // the device leaves music mode by itself when the bulb goes away
+    void set_music(bool enabled, ResponseCallback callback = nullptr);
+
+    // devices only connect when there is something to send, a subscribed
+    // device stays connected so it keeps receiving the bulb's notifications
+    void set_subscribed(bool subscribed);
 
     private:
     // this function assures the operation is sent, even across tcp connections
-    template <typename... Args>
-    void send_operation(std::string method, Args... args);
+    template <typename... Params, typename... Args>
+    void send_operation(ResponseCallback callback, const Method<Params...>& method, Args&&... args);
+
+    void enqueue(Command command);
+
+    void dispatch_now(std::vector<Command> commands, WriteHandler handler);
+
+    void flush_queue();
 
-    void start_listening();
+    void write(std::vector<Command> commands, WriteHandler handler = nullptr);
+
+    void start_writing();
 
     void start_tcp_listening();
 
-    void start_icmp_listening();
+    void handle_message(std::string_view message);
+
+    void handle_notification(const PropertyChange& change);
+
+    void handle_properties(PropertySet requested, const Response& response, const PropertiesCallback& callback);
+
+    // the bulb got another address, everything bound to the old one is redone
+    void move_to(const boost::asio::ip::tcp::endpoint& endpoint);
+
+    [[nodiscard]] bool is_fresh(Property property, std::chrono::milliseconds max_age) const;
+
+    void mark_fresh(PropertySet properties);
+
+    // whatever has to be sent waits for the connection, which is made if needed
+    void want_connection();
 
     void try_connecting();
 
-    void reset_ping_timer();
+    void connect();
 
-    void send_ping();
+    void disconnect();
 
-    bool handle_tcp_error(boost::system::error_code error, std::string info);
+    // after losing the connection, only subscribed devices connect again right away
+    void reconnect();
+
+    void go_idle();
+
+    void fail_waiting();
+
+    void reset_idle_timer();
+
+    void reset_operation_timer();
 
-    bool handle_icmp_error(boost::system::error_code error, std::string info);
+    bool handle_tcp_error(boost::system::error_code error, std::string info);
 
     bool handle_wait_error(boost::system::error_code error, std::string info);
 
-    // io stuff
-    std::shared_ptr<boost::asio::io_context> context;
+    // io stuff, every handler of this device runs on its strand
+    std::shared_ptr<boost::asio::io_context>                     context;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
 
     boost::asio::ip::tcp::endpoint tcp_endpoint;
     boost::asio::ip::tcp::socket   tcp_socket;
 
-    boost::asio::ip::icmp::endpoint icmp_endpoint;
-    boost::asio::ip::icmp::socket   icmp_socket;
+    std::shared_ptr<PingService> pinger;
+    PingService::Handle          ping_handle;
+    PingService::Subscriber      on_liveness; // kept to subscribe again when the address changes
+
+    std::shared_ptr<ConnectScheduler> connector;
+    ConnectScheduler::Handle          connect_handle;
+
+    std::shared_ptr<MusicServer> music;
+    MusicServer::Handle          music_handle;
+    bool                         music_requested; // we asked the bulb to connect to the server
+    bool                         music_active;    // and it did
+
+    // everything written to the socket, frames queue in the outbox while a write is busy
+    struct Outgoing
+    {
+        std::string               data;
+        std::vector<WriteHandler> handlers;
+    };
+
+    std::string               outbox;
+    std::vector<WriteHandler> outbox_handlers;
+    std::shared_ptr<Outgoing> writing;
+    std::shared_ptr<Outgoing> spare; // the previous write, so its buffers can be reused
+
+    // dispatches that came in before we were connected
+    std::vector<std::pair<std::vector<Command>, WriteHandler>> deferred;
 
     // various
-    std::string buffer;
-    State       state;
+    LineReader reader;
+    State      state;
+    bool       subscribed;
 
     // various
-    std::set<uint64_t> pending_requests;
-    uint64_t           message_id;
-    uint64_t           ping_id;
+    CommandQueue queue;
+    PendingTable pending_requests;
+    uint64_t     message_id;
 
     // callback functions
     std::function<void(Parameter, Value)> update_callback;
     std::function<void(Error)>            error_callback;
+    std::function<void(const DeviceState&)> state_callback;
+
+    // the state is read from other threads, so it has its own lock
+    mutable std::mutex state_mutex;
+    DeviceState        device_state;
+
+    // when each property was last read from the bulb, only used on the strand
+    using Timestamps = std::array<std::chrono::steady_clock::time_point, property_names.size()>;
+
+    PropertySet                           known;
+    Timestamps                            fetched_at;
+    std::chrono::steady_clock::time_point connected_at;
 
     // variables for disconnect checking
-    const uint32_t ping_timeout      = 3000;
     const uint32_t operation_timeout = 1000;
+    const uint32_t operation_tick    = 100;
 
     boost::asio::deadline_timer operation_timer;
-    boost::asio::deadline_timer ping_timer;
+    boost::asio::deadline_timer queue_timer;
+
+    // commands that wait longer than this for a connection fail
+    const uint32_t connect_timeout = 5000;
+    boost::asio::deadline_timer connect_timer;
+    bool                        connect_waiting = false;
+
+    // tells the completion of a connect apart from that of an attempt that was given up on
+    uint64_t connect_attempt = 0;
+
+    // an unsubscribed connection closes after being unused for this long
+    std::chrono::milliseconds   idle_timeout;
+    boost::asio::deadline_timer idle_timer;
 
     // static variables
-    constexpr static auto default_duration = std::chrono::milliseconds(300);
+    constexpr static auto default_duration     = std::chrono::milliseconds(300);
+    constexpr static auto default_idle_timeout = std::chrono::milliseconds(30000);
+    constexpr static auto default_max_age      = std::chrono::milliseconds(5000);
     //    inline const static std::map<std::string, Parameter> parameter_map
     //    = { { "powered", powered }, { "power", on }, { "bright", brightness } };
 };
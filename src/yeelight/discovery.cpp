@@ -0,0 +1,52 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/15/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "discovery.h"
+
+#include <algorithm>
+
+namespace yeelight
+{
+
+DiscoverySchedule::DiscoverySchedule()
+: start(clock::now()), burst_left(burst_count), interval(base_interval)
+{
+}
+
+DiscoverySchedule::clock::duration DiscoverySchedule::next()
+{
+    sent++;
+
+    if(burst_left != 0)
+    {
+        burst_left--;
+        return burst_interval;
+    }
+
+    // nothing new since the last search, so wait longer for the next one
+    const auto result = interval;
+    interval          = std::min<clock::duration>(interval * 2, max_interval);
+    return result;
+}
+
+void DiscoverySchedule::found_new()
+{
+    interval = base_interval;
+}
+
+void DiscoverySchedule::trigger()
+{
+    burst_left = burst_count;
+    interval   = base_interval;
+}
+
+uint64_t DiscoverySchedule::saved() const
+{
+    const auto fixed = static_cast<uint64_t>((clock::now() - start) / base_interval) + 1;
+    return fixed > sent ? fixed - sent : 0;
+}
+
+} // namespace yeelight
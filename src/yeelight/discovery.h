@@ -0,0 +1,54 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/15/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+namespace yeelight
+{
+
+// Decides when the next M-SEARCH goes out. Every bulb answers every search,
+// so we only search a lot at startup or when something changed, and slowly
+// back off while the set of devices stays the same. The bulbs announce
+// themselves on their own as well, listening for that is the main source.
+class DiscoverySchedule
+{
+    public:
+    using clock = std::chrono::steady_clock;
+
+    DiscoverySchedule();
+
+    // call when a search is sent, returns how long to wait for the next one
+    clock::duration next();
+
+    // a device we did not know yet answered, keep searching at the fast rate
+    void found_new();
+
+    // something changed (a device went away, a stranger announced itself), search again soon
+    void trigger();
+
+    // the searches that were not sent compared to searching every second,
+    // this one can be called from any thread
+    [[nodiscard]] uint64_t saved() const;
+
+    private:
+    clock::time_point     start;
+    std::atomic<uint64_t> sent = 0;
+
+    size_t          burst_left;
+    clock::duration interval;
+
+    constexpr static size_t burst_count    = 5;
+    constexpr static auto   burst_interval = std::chrono::milliseconds(250);
+    constexpr static auto   base_interval  = std::chrono::seconds(1);
+    constexpr static auto   max_interval   = std::chrono::minutes(5);
+};
+
+} // namespace yeelight
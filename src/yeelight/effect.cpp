@@ -0,0 +1,284 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/22/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "effect.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+void unpack(dot::color color, float (&channels)[3])
+{
+    const auto rgb = dot::color::to_rgb(color);
+    channels[0]    = static_cast<float>((rgb >> 16) & 0xFF);
+    channels[1]    = static_cast<float>((rgb >> 8) & 0xFF);
+    channels[2]    = static_cast<float>(rgb & 0xFF);
+}
+
+float fract(float value)
+{
+    return value - std::floor(value);
+}
+
+// with amount in [0, 1], the same for every channel so these stay branchless loops
+void blend(const float (&from)[3], const float (&to)[3], const std::vector<float>& amount, yeelight::Frame& frame)
+{
+    const auto size = frame.size();
+    for(size_t i = 0; i < size; i++) frame.red[i] = from[0] + (to[0] - from[0]) * amount[i];
+    for(size_t i = 0; i < size; i++) frame.green[i] = from[1] + (to[1] - from[1]) * amount[i];
+    for(size_t i = 0; i < size; i++) frame.blue[i] = from[2] + (to[2] - from[2]) * amount[i];
+}
+
+uint32_t quantize(float value, float low, float high)
+{
+    return static_cast<uint32_t>(std::clamp(value, low, high) + 0.5f);
+}
+
+// the effects fill the frame in place, this is the only scratch space they share
+thread_local std::vector<float> amount;
+
+} // namespace
+
+namespace yeelight
+{
+
+Gradient::Gradient(dot::color from, dot::color to, float speed, float brightness)
+: speed(speed), brightness(brightness)
+{
+    unpack(from, this->from);
+    unpack(to, this->to);
+}
+
+void Gradient::render(double time, const std::vector<float>& positions, Frame& frame) const
+{
+    const auto cycles = time * static_cast<double>(speed);
+    const auto offset = static_cast<float>(cycles - std::floor(cycles));
+
+    amount.resize(frame.size());
+    for(size_t i = 0; i < frame.size(); i++) amount[i] = 1 - std::abs(2 * fract(positions[i] + offset) - 1);
+
+    blend(from, to, amount, frame);
+    std::fill(frame.brightness.begin(), frame.brightness.end(), brightness);
+}
+
+Chase::Chase(dot::color head, dot::color background, float width, float speed, float brightness)
+: width(std::max(width, 0.001f)), speed(speed), brightness(brightness)
+{
+    unpack(head, this->head);
+    unpack(background, this->background);
+}
+
+void Chase::render(double time, const std::vector<float>& positions, Frame& frame) const
+{
+    const auto cycles = time * static_cast<double>(speed);
+    const auto offset = static_cast<float>(cycles - std::floor(cycles));
+
+    // full color at the head, fading out behind it over the width
+    amount.resize(frame.size());
+    for(size_t i = 0; i < frame.size(); i++) amount[i] = std::max(0.0f, 1 - fract(offset - positions[i]) / width);
+
+    blend(background, head, amount, frame);
+    std::fill(frame.brightness.begin(), frame.brightness.end(), brightness);
+}
+
+Fade::Fade(dot::color from, dot::color to, std::chrono::milliseconds period, float brightness)
+: period(std::max<double>(period.count(), 1) / 1000.0), brightness(brightness)
+{
+    unpack(from, this->from);
+    unpack(to, this->to);
+}
+
+void Fade::render(double time, const std::vector<float>&, Frame& frame) const
+{
+    const auto phase = static_cast<float>(fract(time / period));
+
+    amount.assign(frame.size(), 1 - std::abs(2 * phase - 1));
+    blend(from, to, amount, frame);
+    std::fill(frame.brightness.begin(), frame.brightness.end(), brightness);
+}
+
+////////////////////////////////////////////////////
+
+EffectEngine::EffectEngine(std::shared_ptr<boost::asio::io_context> context,
+                           std::vector<Device*>                     devices,
+                           std::chrono::milliseconds                interval)
+: context(std::move(context)), strand(boost::asio::make_strand(*this->context)), timer(strand),
+  interval(std::max(interval, std::chrono::milliseconds(1))), devices(std::move(devices)), positions(),
+  effect(), started(), deadline(), frame(this->devices.size()), colors(this->devices.size()),
+  levels(this->devices.size()), tracking(std::make_shared<Tracking>()), overrun_callback()
+{
+    const auto size = this->devices.size();
+
+    positions.resize(size);
+    for(size_t i = 0; i < size; i++) positions[i] = static_cast<float>(i) / static_cast<float>(size);
+
+    tracking->colors.resize(size, unknown);
+    tracking->levels.resize(size, unknown);
+    tracking->stats.budget = this->interval;
+}
+
+EffectEngine::~EffectEngine()
+{
+    // everything posted before this runs first, and a timer that already expired
+    // can still have its handler on the way, which then lets us go instead
+    boost::asio::post(strand, [this]() {
+        effect  = nullptr;
+        closing = true;
+
+        if(waiting == 0) closed.set_value();
+        else timer.cancel();
+    });
+    closed.get_future().wait();
+}
+
+void EffectEngine::play(std::shared_ptr<const Effect> new_effect)
+{
+    boost::asio::post(strand, [this, new_effect = std::move(new_effect)]() {
+        const auto playing = effect != nullptr;
+
+        effect   = new_effect;
+        started  = std::chrono::steady_clock::now();
+        deadline = started;
+
+        if(not playing) start_timer();
+    });
+}
+
+void EffectEngine::stop()
+{
+    boost::asio::post(strand, [this]() {
+        effect = nullptr;
+        timer.cancel();
+    });
+}
+
+EffectStats EffectEngine::stats() const
+{
+    const auto lock = std::lock_guard(tracking->mutex);
+    return tracking->stats;
+}
+
+void EffectEngine::set_overrun_callback(std::function<void(const EffectStats&)> callback)
+{
+    boost::asio::post(strand, [this, callback = std::move(callback)]() { overrun_callback = callback; });
+}
+
+void EffectEngine::start_timer()
+{
+    // the deadlines are fixed, so slow frames do not push every frame after them back
+    const auto now = std::chrono::steady_clock::now();
+    deadline += interval;
+
+    if(deadline < now)
+    {
+        const auto behind = static_cast<uint64_t>((now - deadline) / interval);
+        deadline += behind * interval;
+
+        const auto lock = std::lock_guard(tracking->mutex);
+        tracking->stats.dropped += behind;
+    }
+
+    const auto handler = [this](auto error) {
+        waiting--;
+        if(closing)
+        {
+            if(waiting == 0) closed.set_value();
+            return;
+        }
+        if(error or effect == nullptr) return;
+
+        render_frame();
+        start_timer();
+    };
+
+    const auto wait = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - now);
+    timer.expires_from_now(boost::posix_time::milliseconds(std::max<int64_t>(wait.count(), 0)));
+    timer.async_wait(handler);
+    waiting++;
+}
+
+void EffectEngine::render_frame()
+{
+    const auto begin = std::chrono::steady_clock::now();
+    const auto time  = std::chrono::duration<double>(begin - started).count();
+
+    effect->render(time, positions, frame);
+
+    const auto size = frame.size();
+    for(size_t i = 0; i < size; i++)
+    {
+        colors[i] = quantize(frame.red[i], 0, 255) << 16 | quantize(frame.green[i], 0, 255) << 8
+                    | quantize(frame.blue[i], 0, 255);
+    }
+    for(size_t i = 0; i < size; i++) levels[i] = quantize(frame.brightness[i], 1, 100);
+
+    send_changes();
+
+    const auto spent = std::chrono::duration_cast<EffectStats::duration>(std::chrono::steady_clock::now() - begin);
+
+    EffectStats stats;
+    {
+        const auto lock = std::lock_guard(tracking->mutex);
+        auto&      total = tracking->stats;
+
+        total.frames++;
+        total.last    = spent;
+        total.worst   = std::max(total.worst, spent);
+        total.average = total.average + (spent - total.average) / static_cast<int64_t>(total.frames);
+        if(spent <= total.budget) return;
+
+        total.late++;
+        stats = total;
+    }
+
+    if(overrun_callback != nullptr) overrun_callback(stats);
+}
+
+void EffectEngine::send_changes()
+{
+    // the transition spans the frame, so the bulbs move smoothly from one to the next
+    const auto duration = interval;
+
+    std::vector<std::pair<size_t, bool>> changed; // the bulb, and whether its color changed rather than its brightness
+    {
+        const auto lock = std::lock_guard(tracking->mutex);
+        for(size_t i = 0; i < devices.size(); i++)
+        {
+            if(tracking->colors[i] != colors[i]) changed.emplace_back(i, true);
+            if(tracking->levels[i] != levels[i]) changed.emplace_back(i, false);
+
+            tracking->colors[i] = colors[i];
+            tracking->levels[i] = levels[i];
+        }
+        tracking->stats.commands += changed.size();
+        tracking->stats.in_flight += changed.size();
+    }
+
+    for(const auto& [index, color] : changed)
+    {
+        // a failed command makes the bulb's value unknown again, so the next frame sends it anew
+        auto callback = [tracking = tracking, index = index, color = color](const Response& response) {
+            const auto lock = std::lock_guard(tracking->mutex);
+            tracking->stats.in_flight--;
+
+            if(response.error == Error::superseded) tracking->stats.superseded++;
+            else if(response.error != Error::none)
+            {
+                tracking->stats.failed++;
+                (color ? tracking->colors : tracking->levels)[index] = unknown;
+            }
+        };
+
+        const auto rgb = colors[index];
+        if(color)
+            devices[index]->set_rgb_color(dot::color((rgb >> 16) & 0xFF, (rgb >> 8) & 0xFF, rgb & 0xFF), duration, callback);
+        else
+            devices[index]->set_brightness(levels[index], duration, callback);
+    }
+}
+
+} // namespace yeelight
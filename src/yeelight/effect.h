@@ -0,0 +1,195 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/22/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <utility/color.h>
+
+#include "device.h"
+
+namespace yeelight
+{
+
+// The colors of every bulb for one frame. Every channel has its own array,
+// so an effect is a handful of plain loops the compiler can vectorize.
+struct Frame
+{
+    explicit Frame(size_t size = 0) : red(size), green(size), blue(size), brightness(size) {}
+
+    [[nodiscard]] size_t size() const { return red.size(); }
+
+    std::vector<float> red;        // 0 to 255
+    std::vector<float> green;      // 0 to 255
+    std::vector<float> blue;       // 0 to 255
+    std::vector<float> brightness; // 1 to 100
+};
+
+// An effect colors every bulb for a moment in time, in seconds since it started.
+// The position of a bulb is where it sits in the fleet, between 0 and 1.
+// Rendering happens on the engine's strand, an effect has to write every channel.
+class Effect
+{
+    public:
+    virtual ~Effect() = default;
+
+    virtual void render(double time, const std::vector<float>& positions, Frame& frame) const = 0;
+};
+
+// goes from one color to the other and back over the fleet, moving along at speed fleets a second
+class Gradient : public Effect
+{
+    public:
+    Gradient(dot::color from, dot::color to, float speed = 0, float brightness = 100);
+
+    void render(double time, const std::vector<float>& positions, Frame& frame) const override;
+
+    private:
+    float from[3];
+    float to[3];
+    float speed;
+    float brightness;
+};
+
+// a band of color that runs over the background, width is the part of the fleet it covers
+class Chase : public Effect
+{
+    public:
+    Chase(dot::color head, dot::color background, float width = 0.2f, float speed = 0.5f, float brightness = 100);
+
+    void render(double time, const std::vector<float>& positions, Frame& frame) const override;
+
+    private:
+    float head[3];
+    float background[3];
+    float width;
+    float speed;
+    float brightness;
+};
+
+// every bulb goes from one color to the other and back, once every period
+class Fade : public Effect
+{
+    public:
+    Fade(dot::color from, dot::color to, std::chrono::milliseconds period, float brightness = 100);
+
+    void render(double time, const std::vector<float>& positions, Frame& frame) const override;
+
+    private:
+    float from[3];
+    float to[3];
+    double period;
+    float  brightness;
+};
+
+struct EffectStats
+{
+    using duration = std::chrono::microseconds;
+
+    duration budget{};  // the time between two frames
+    duration last{};    // rendering plus handing the changes to the devices, for the last frame
+    duration worst{};
+    duration average{};
+
+    uint64_t frames  = 0;
+    uint64_t late    = 0; // frames that took longer than the budget
+    uint64_t dropped = 0; // frames that were skipped because we fell behind
+
+    // the network side: a superseded command was replaced by a newer one before
+    // it was sent, so the devices cannot keep up with the frame rate
+    uint64_t commands   = 0;
+    uint64_t superseded = 0;
+    uint64_t failed     = 0;
+    uint64_t in_flight  = 0;
+};
+
+// Renders an effect for a fleet at a fixed frame rate. Each frame is compared
+// to what was last sent, only the bulbs that changed get a command, which goes
+// through their usual queue so it replaces the one that is still waiting.
+// Without music mode a bulb takes about one command a second, put the devices
+// in music mode for anything faster.
+// All public functions can be called from any thread.
+class EffectEngine
+{
+    public:
+    EffectEngine(std::shared_ptr<boost::asio::io_context> context,
+                 std::vector<Device*>                     devices,
+                 std::chrono::milliseconds                interval = default_interval);
+
+    // waits until the strand is done with the engine, so the context has to be running
+    // on another thread and the engine cannot be destroyed from its own callbacks
+    ~EffectEngine();
+
+    EffectEngine(const EffectEngine&) = delete;
+
+    EffectEngine operator=(const EffectEngine&) = delete;
+
+    // starts the effect from time zero, replacing the one that is playing
+    void play(std::shared_ptr<const Effect> effect);
+
+    // the bulbs keep the last frame
+    void stop();
+
+    [[nodiscard]] EffectStats stats() const;
+
+    // called from the engine's strand after every frame that went over its budget
+    void set_overrun_callback(std::function<void(const EffectStats&)> callback);
+
+    private:
+    // what the devices were told, shared with the callbacks of the commands
+    struct Tracking
+    {
+        std::mutex            mutex;
+        std::vector<uint32_t> colors;
+        std::vector<uint32_t> levels;
+        EffectStats           stats;
+    };
+
+    void start_timer();
+
+    void render_frame();
+
+    void send_changes();
+
+    std::shared_ptr<boost::asio::io_context>                     context;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+    boost::asio::deadline_timer                                  timer;
+    std::chrono::milliseconds                                    interval;
+
+    std::vector<Device*> devices;
+    std::vector<float>   positions;
+
+    std::shared_ptr<const Effect>         effect;
+    std::chrono::steady_clock::time_point started;
+    std::chrono::steady_clock::time_point deadline;
+
+    // only touched from the strand
+    Frame                 frame;
+    std::vector<uint32_t> colors;
+    std::vector<uint32_t> levels;
+
+    std::shared_ptr<Tracking>               tracking;
+    std::function<void(const EffectStats&)> overrun_callback;
+
+    // timer handlers that still have to run, a stop followed by a play can leave two of
+    // them, the destructor waits for all of them
+    size_t             waiting = 0;
+    bool               closing = false;
+    std::promise<void> closed;
+
+    constexpr static auto     default_interval = std::chrono::milliseconds(50); // 20 frames a second
+    constexpr static uint32_t unknown          = 0xFFFFFFFF; // no rgb value or brightness looks like this
+};
+
+} // namespace yeelight
@@ -0,0 +1,133 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/21/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "flow.h"
+#include "schema.h"
+
+#include <stdexcept>
+
+namespace
+{
+using namespace yeelight;
+
+uint64_t flow_value(const flow_state& state)
+{
+    switch(state.mode)
+    {
+    case color_mode::temperature: return state.temperature;
+    case color_mode::rgb: return dot::color::to_rgb(state.color);
+    case color_mode::sleep: return 0;
+    default: throw std::logic_error("cannot put color flow in hsv mode");
+    }
+}
+
+// every state as duration, mode, value and brightness, behind the action
+std::vector<uint64_t> make_key(flow_stop_action action, const std::vector<flow_state>& states)
+{
+    std::vector<uint64_t> result;
+    result.reserve(1 + 4 * states.size());
+
+    result.push_back(static_cast<uint64_t>(action));
+    for(const auto& state : states)
+    {
+        result.push_back(static_cast<uint64_t>(state.duration.count()));
+        result.push_back(static_cast<uint64_t>(state.mode));
+        result.push_back(flow_value(state));
+        result.push_back(state.brightness);
+    }
+    return result;
+}
+
+uint64_t hash_key(const std::vector<uint64_t>& key)
+{
+    // fnv-1a, the cache compares the keys themselves anyway
+    uint64_t result = 14695981039346656037ull;
+    for(auto value : key)
+    {
+        for(size_t i = 0; i < sizeof(value); i++, value >>= 8) result = (result ^ (value & 0xFF)) * 1099511628211ull;
+    }
+    return result;
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+CompiledFlow::CompiledFlow(flow_stop_action action, const std::vector<flow_state>& states)
+{
+    if(states.empty()) throw std::logic_error("a color flow needs at least one state");
+
+    for(const auto& state : states)
+    {
+        if(state.duration < std::chrono::milliseconds(50))
+            throw std::logic_error("color flow states have to last at least 50 ms");
+        if(state.mode != color_mode::sleep and (state.brightness < 1 or state.brightness > 100))
+            throw std::logic_error("color flow brightness has to be between 1 and 100");
+    }
+
+    const auto key = make_key(action, states);
+    content_hash   = hash_key(key);
+
+    // one pass over the states, the expression is a list of 4-tuples in a single string
+    serialized.reserve(16 + states.size() * 28);
+    serialized += '[';
+    append_param(serialized, states.size());
+    serialized += ',';
+    append_param(serialized, key[0]);
+    serialized += ",\"";
+
+    for(size_t i = 1; i < key.size(); i++)
+    {
+        if(i != 1) serialized += ',';
+        append_param(serialized, key[i]);
+    }
+    serialized += "\"]";
+}
+
+Command CompiledFlow::command(ResponseCallback callback) const
+{
+    return Command{ method::start_cf.name, serialized, std::move(callback), method::start_cf.coalesce };
+}
+
+FlowCache::FlowCache(size_t capacity) : flows(), mutex(), capacity(capacity) {}
+
+std::shared_ptr<const CompiledFlow> FlowCache::get(flow_stop_action action, const std::vector<flow_state>& states)
+{
+    auto       key  = make_key(action, states);
+    const auto hash = hash_key(key);
+
+    const auto lock = std::lock_guard(mutex);
+    const auto iter = flows.find(hash);
+
+    if(iter != flows.end())
+    {
+        for(const auto& entry : iter->second)
+        {
+            if(entry.key == key) return entry.flow;
+        }
+    }
+
+    // nothing is inserted before it compiled, an invalid flow throws and leaves the cache as it was
+    auto flow = std::make_shared<const CompiledFlow>(action, states);
+    if(count >= capacity)
+    {
+        flows.clear();
+        count = 0;
+    }
+
+    flows[hash].push_back(Entry{ std::move(key), flow });
+    count++;
+    return flow;
+}
+
+size_t FlowCache::size() const
+{
+    const auto lock = std::lock_guard(mutex);
+    return count;
+}
+
+} // namespace yeelight
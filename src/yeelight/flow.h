@@ -0,0 +1,72 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/21/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "queue.h"
+#include "util.h"
+
+namespace yeelight
+{
+
+// A color flow that is checked and serialized once. It never changes after
+// that, so one flow can be started on any number of devices from any thread,
+// which only copies the serialized parameters into their commands.
+class CompiledFlow
+{
+    public:
+    // throws std::logic_error for a state the bulb cannot flow to
+    CompiledFlow(flow_stop_action action, const std::vector<flow_state>& states);
+
+    // the parameters of start_cf, [count,action,"duration,mode,value,brightness,..."]
+    [[nodiscard]] const std::string& params() const { return serialized; }
+
+    [[nodiscard]] uint64_t hash() const { return content_hash; }
+
+    [[nodiscard]] Command command(ResponseCallback callback) const;
+
+    private:
+    std::string serialized;
+    uint64_t    content_hash;
+};
+
+// Compiled flows by their content, so a scene that is replayed does not
+// compile its flows again. It forgets everything once it is full.
+// It can be used from any thread.
+class FlowCache
+{
+    public:
+    explicit FlowCache(size_t capacity = default_capacity);
+
+    std::shared_ptr<const CompiledFlow> get(flow_stop_action action, const std::vector<flow_state>& states);
+
+    [[nodiscard]] size_t size() const;
+
+    private:
+    struct Entry
+    {
+        std::vector<uint64_t>               key; // the flow as plain numbers, to tell apart equal hashes
+        std::shared_ptr<const CompiledFlow> flow;
+    };
+
+    std::unordered_map<uint64_t, std::vector<Entry>> flows;
+    size_t                                           count = 0;
+
+    mutable std::mutex mutex;
+    size_t             capacity;
+
+    constexpr static size_t default_capacity = 256;
+};
+
+} // namespace yeelight
@@ -0,0 +1,272 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/20/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "music.h"
+#include "schema.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace
+{
+void fail(std::vector<yeelight::Command>& commands, yeelight::Error error)
+{
+    for(auto& command : std::exchange(commands, {}))
+    {
+        if(command.callback != nullptr) command.callback(yeelight::Response{ 0, error, nullptr, {} });
+    }
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+MusicServer::MusicServer(std::shared_ptr<boost::asio::io_context> context, uint16_t port, std::chrono::milliseconds interval)
+: context(std::move(context)), strand(boost::asio::make_strand(*this->context)), mutex(), acceptor(strand),
+  timer(strand), interval(interval), entries(), free_entries()
+{
+    const auto endpoint = boost::asio::ip::tcp::endpoint(boost::asio::ip::tcp::v4(), port);
+
+    acceptor.open(endpoint.protocol());
+    acceptor.set_option(boost::asio::ip::tcp::acceptor::reuse_address(true));
+    acceptor.bind(endpoint);
+    acceptor.listen();
+
+    start_accept();
+}
+
+uint16_t MusicServer::port() const
+{
+    return acceptor.local_endpoint().port();
+}
+
+boost::asio::ip::address_v4 MusicServer::local_address(boost::asio::ip::address_v4 remote) const
+{
+    // connecting a udp socket only picks the route, nothing goes over the network
+    boost::system::error_code    error;
+    boost::asio::ip::udp::socket probe(*context);
+
+    probe.connect(boost::asio::ip::udp::endpoint(remote, 1), error);
+    if(error) return boost::asio::ip::address_v4::any();
+
+    const auto endpoint = probe.local_endpoint(error);
+    if(error) return boost::asio::ip::address_v4::any();
+
+    return endpoint.address().to_v4();
+}
+
+MusicServer::Handle MusicServer::add(boost::asio::ip::address_v4 address, Listener listener)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    Handle handle;
+    if(free_entries.empty())
+    {
+        handle = entries.size();
+        entries.emplace_back();
+    }
+    else
+    {
+        handle = free_entries.back();
+        free_entries.pop_back();
+    }
+
+    auto& entry    = entries[handle];
+    entry          = Entry();
+    entry.address  = address;
+    entry.active   = true;
+    entry.listener = std::move(listener);
+
+    active++;
+    if(not ticking)
+    {
+        boost::asio::post(strand, [this]() {
+            const auto lock = std::lock_guard(mutex);
+            start_timer();
+        });
+        ticking = true;
+    }
+
+    return handle;
+}
+
+void MusicServer::remove(Handle handle)
+{
+    std::vector<Command> frame;
+    {
+        const auto lock = std::lock_guard(mutex);
+
+        auto& entry = entries.at(handle);
+        frame.swap(entry.frame);
+
+        // the socket belongs to our strand, whatever it was doing fails with operation_aborted
+        if(entry.connection != nullptr)
+        {
+            boost::asio::post(strand, [connection = entry.connection]() {
+                boost::system::error_code ignored;
+                connection->socket.close(ignored);
+            });
+        }
+
+        entry = Entry();
+        free_entries.emplace_back(handle);
+        active--;
+    }
+    fail(frame, Error::not_connected);
+}
+
+void MusicServer::push(Handle handle, Command command)
+{
+    std::optional<Command> replaced;
+    {
+        const auto lock = std::lock_guard(mutex);
+
+        auto&      frame = entries.at(handle).frame;
+        const auto same  = [&](const auto& elem) { return elem.method == command.method; };
+        const auto iter  = std::find_if(frame.begin(), frame.end(), same);
+
+        if(iter == frame.end())
+            frame.emplace_back(std::move(command));
+        else
+            replaced = std::exchange(*iter, std::move(command));
+    }
+
+    if(replaced and replaced->callback != nullptr)
+        replaced->callback(Response{ 0, Error::superseded, nullptr, {} });
+}
+
+void MusicServer::start_timer()
+{
+    if(active == 0)
+    {
+        ticking = false;
+        return;
+    }
+
+    const auto handler = [this](auto error) {
+        if(error) return;
+
+        const auto lock = std::lock_guard(mutex);
+        for(size_t i = 0; i < entries.size(); i++) flush(i);
+        start_timer();
+    };
+
+    timer.expires_from_now(boost::posix_time::milliseconds(interval.count()));
+    timer.async_wait(handler);
+}
+
+void MusicServer::flush(Handle handle)
+{
+    auto& entry = entries[handle];
+    if(not entry.active or entry.writing or entry.connection == nullptr or entry.frame.empty()) return;
+
+    // the bulb does not answer in music mode, but it still expects an id
+    auto connection = entry.connection;
+    connection->data.clear();
+    for(auto& command : entry.frame)
+    {
+        append_frame(connection->data, message_id++, command);
+        connection->callbacks.emplace_back(std::move(command.callback));
+    }
+    entry.frame.clear();
+    entry.writing = true;
+
+    const auto handler = [this, handle, connection](auto error, auto) {
+        std::vector<ResponseCallback> callbacks;
+        {
+            const auto lock = std::lock_guard(mutex);
+            callbacks.swap(connection->callbacks);
+
+            if(entries[handle].connection == connection)
+            {
+                entries[handle].writing = false;
+                if(error) lost(handle, connection);
+            }
+        }
+
+        const auto result = error ? Error::not_connected : Error::none;
+        for(const auto& callback : callbacks)
+        {
+            if(callback != nullptr) callback(Response{ 0, result, nullptr, {} });
+        }
+    };
+
+    boost::asio::async_write(connection->socket, boost::asio::buffer(connection->data), handler);
+}
+
+void MusicServer::lost(Handle handle, const std::shared_ptr<Connection>& connection)
+{
+    auto& entry = entries[handle];
+    if(entry.connection != connection) return;
+
+    boost::system::error_code ignored;
+    connection->socket.close(ignored);
+
+    entry.connection = nullptr;
+    entry.writing    = false;
+    fail(entry.frame, Error::not_connected);
+
+    if(entry.listener != nullptr) entry.listener(false);
+}
+
+void MusicServer::start_accept()
+{
+    auto connection = std::make_shared<Connection>(strand);
+
+    const auto handler = [this, connection](auto error) {
+        if(error == boost::asio::error::operation_aborted) return;
+        if(error)
+        {
+            start_accept();
+            return;
+        }
+
+        boost::system::error_code ignored;
+        const auto                remote = connection->socket.remote_endpoint(ignored).address();
+        const auto                bulb   = remote.is_v4() ? remote.to_v4() : boost::asio::ip::address_v4::any();
+
+        {
+            const auto lock = std::lock_guard(mutex);
+
+            // only bulbs we asked to connect are let in
+            const auto same = [&](const auto& elem) {
+                return elem.active and elem.connection == nullptr and elem.address == bulb;
+            };
+            const auto iter = std::find_if(entries.begin(), entries.end(), same);
+
+            if(iter == entries.end())
+            {
+                connection->socket.close(ignored);
+            }
+            else
+            {
+                const auto handle = static_cast<Handle>(iter - entries.begin());
+                iter->connection  = connection;
+                if(iter->listener != nullptr) iter->listener(true);
+                start_reading(handle, connection);
+            }
+        }
+        start_accept();
+    };
+
+    acceptor.async_accept(connection->socket, handler);
+}
+
+void MusicServer::start_reading(Handle handle, const std::shared_ptr<Connection>& connection)
+{
+    const auto handler = [this, handle, connection](auto error, auto) {
+        if(error == boost::asio::error::operation_aborted) return;
+
+        const auto lock = std::lock_guard(mutex);
+        if(error) lost(handle, connection);
+        else start_reading(handle, connection);
+    };
+
+    connection->socket.async_read_some(boost::asio::buffer(connection->scratch), handler);
+}
+
+} // namespace yeelight
@@ -0,0 +1,111 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/20/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#include "queue.h"
+
+namespace yeelight
+{
+
+// After set_music the bulb connects back to us and takes commands on that
+// connection without its quota of 60 a minute, and without answering them.
+// Every device gets a slot that only holds the newest command of each method,
+// all slots are written out together every tick, so the bulb gets at most one
+// write per frame no matter how fast the commands come in.
+// Listeners and callbacks are called from the server's strand, they should not block.
+class MusicServer
+{
+    public:
+    using Handle   = size_t;
+    using Listener = std::function<void(bool connected)>;
+
+    explicit MusicServer(std::shared_ptr<boost::asio::io_context> context,
+                         uint16_t                                 port     = 0,
+                         std::chrono::milliseconds                interval = default_interval);
+
+    MusicServer(const MusicServer&) = delete;
+
+    MusicServer operator=(const MusicServer&) = delete;
+
+    // the port the bulbs have to connect to, a free one if none was given
+    [[nodiscard]] uint16_t port() const;
+
+    // the address of ours that the device can reach, found without sending anything
+    [[nodiscard]] boost::asio::ip::address_v4 local_address(boost::asio::ip::address_v4 remote) const;
+
+    // waits for the device with this address to connect, the listener hears when it comes and goes
+    Handle add(boost::asio::ip::address_v4 address, Listener listener);
+
+    // closes the connection, which makes the bulb leave music mode
+    void remove(Handle handle);
+
+    // replaces the waiting command with the same method, the callback is called once it is written
+    void push(Handle handle, Command command);
+
+    private:
+    struct Connection
+    {
+        explicit Connection(boost::asio::strand<boost::asio::io_context::executor_type>& strand) : socket(strand) {}
+
+        boost::asio::ip::tcp::socket  socket;
+        std::string                   data; // what is being written, kept for the next write
+        std::vector<ResponseCallback> callbacks;
+        std::array<char, 256>         scratch; // the bulb does not answer, we only read to notice it leaving
+    };
+
+    struct Entry
+    {
+        boost::asio::ip::address_v4 address;
+        bool                        active  = false;
+        bool                        writing = false;
+
+        Listener                    listener;
+        std::vector<Command>        frame; // the newest command of every method
+        std::shared_ptr<Connection> connection;
+    };
+
+    // these expect the lock to be held
+    void start_timer();
+
+    void flush(Handle handle);
+
+    void lost(Handle handle, const std::shared_ptr<Connection>& connection);
+
+    void start_accept();
+
+    void start_reading(Handle handle, const std::shared_ptr<Connection>& connection);
+
+    std::shared_ptr<boost::asio::io_context>                     context;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+
+    // guards the entries, devices push from their own strands
+    mutable std::mutex mutex;
+
+    boost::asio::ip::tcp::acceptor acceptor;
+    boost::asio::deadline_timer    timer;
+    std::chrono::milliseconds      interval;
+    bool                           ticking = false;
+
+    std::vector<Entry>  entries;
+    std::vector<Handle> free_entries;
+    size_t              active = 0;
+    uint64_t            message_id = 1;
+
+    constexpr static auto default_interval = std::chrono::milliseconds(33); // 30 frames a second
+};
+
+} // namespace yeelight
@@ -0,0 +1,280 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/18/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "notification.h"
+
+#include <algorithm>
+#include <charconv>
+
+namespace
+{
+// just enough json to walk over a flat object, every value is returned as it is written
+class Cursor
+{
+    public:
+    explicit Cursor(std::string_view input) : rest(input) {}
+
+    bool consume(char expected)
+    {
+        if(not peek(expected)) return false;
+        rest.remove_prefix(1);
+        return true;
+    }
+
+    bool peek(char expected)
+    {
+        skip_whitespace();
+        return not rest.empty() and rest.front() == expected;
+    }
+
+    // the contents between the quotes, escapes are left alone
+    std::optional<std::string_view> string()
+    {
+        if(not consume('"')) return std::nullopt;
+
+        for(size_t i = 0; i < rest.size(); i++)
+        {
+            if(rest[i] == '\\')
+            {
+                i++;
+            }
+            else if(rest[i] == '"')
+            {
+                const auto result = rest.substr(0, i);
+                rest.remove_prefix(i + 1);
+                return result;
+            }
+        }
+        return std::nullopt;
+    }
+
+    // a string or a number, true, false or null
+    std::optional<std::string_view> scalar()
+    {
+        if(peek('"')) return string();
+
+        const auto end = rest.find_first_of(",}] \t\r\n");
+        if(end == 0 or end == std::string_view::npos) return std::nullopt;
+
+        const auto result = rest.substr(0, end);
+        rest.remove_prefix(end);
+        return result;
+    }
+
+    // for the values we are not interested in, which may be objects or arrays
+    bool skip_value()
+    {
+        if(not peek('{') and not peek('[')) return scalar().has_value();
+
+        size_t depth = 0;
+        do
+        {
+            if(peek('"'))
+            {
+                if(not string()) return false;
+                continue;
+            }
+            if(rest.empty()) return false;
+
+            if(rest.front() == '{' or rest.front() == '[') depth++;
+            else if(rest.front() == '}' or rest.front() == ']') depth--;
+            rest.remove_prefix(1);
+        } while(depth != 0);
+
+        return true;
+    }
+
+    private:
+    void skip_whitespace()
+    {
+        while(not rest.empty() and (rest.front() == ' ' or rest.front() == '\t' or rest.front() == '\r' or rest.front() == '\n'))
+            rest.remove_prefix(1);
+    }
+
+    std::string_view rest;
+};
+
+std::optional<uint32_t> parse_number(std::string_view value)
+{
+    uint32_t   result;
+    const auto end = value.data() + value.size();
+    const auto [ptr, error] = std::from_chars(value.data(), end, result);
+
+    if(error != std::errc() or ptr != end) return std::nullopt;
+    return result;
+}
+
+// the bulb sends numbers as strings, but it does not hurt to accept both
+bool parse_params(Cursor& cursor, yeelight::PropertyChange& change)
+{
+    if(not cursor.consume('{')) return false;
+    if(cursor.consume('}')) return true;
+
+    do
+    {
+        const auto key = cursor.string();
+        if(not key or not cursor.consume(':')) return false;
+
+        if(*key == "name")
+        {
+            change.name = cursor.string();
+            if(not change.name) return false;
+            continue;
+        }
+        if(cursor.peek('{') or cursor.peek('['))
+        {
+            if(not cursor.skip_value()) return false;
+            continue;
+        }
+
+        const auto value = cursor.scalar();
+        if(not value) return false;
+
+        const auto property = yeelight::find_property(*key);
+        if(property) yeelight::set_property(change, *property, *value);
+    } while(cursor.consume(','));
+
+    return cursor.consume('}');
+}
+
+std::string unescape(std::string_view value)
+{
+    std::string result;
+    result.reserve(value.size());
+
+    for(size_t i = 0; i < value.size(); i++)
+    {
+        if(value[i] != '\\' or i + 1 == value.size())
+        {
+            result += value[i];
+            continue;
+        }
+
+        switch(value[++i])
+        {
+        case 'n': result += '\n'; break;
+        case 't': result += '\t'; break;
+        case 'r': result += '\r'; break;
+        case 'u':
+        {
+            // only ascii, anything else would need a proper utf-8 encoder
+            uint32_t   code = 0;
+            const auto digits = value.substr(i + 1, 4);
+            std::from_chars(digits.data(), digits.data() + digits.size(), code, 16);
+            result += code < 0x80 ? static_cast<char>(code) : '?';
+            i += digits.size();
+            break;
+        }
+        default: result += value[i]; break;
+        }
+    }
+    return result;
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+std::optional<PropertyChange> parse_notification(std::string_view message)
+{
+    Cursor cursor(message);
+    if(not cursor.consume('{') or cursor.consume('}')) return std::nullopt;
+
+    PropertyChange result;
+    bool           props  = false;
+    bool           params = false;
+
+    do
+    {
+        const auto key = cursor.string();
+        if(not key or not cursor.consume(':')) return std::nullopt;
+
+        // responses to our own requests are handled elsewhere
+        if(*key == "id") return std::nullopt;
+
+        if(*key == "method")
+        {
+            const auto method = cursor.string();
+            if(not method) return std::nullopt;
+            props = *method == "props";
+        }
+        else if(*key == "params" and cursor.peek('{'))
+        {
+            if(not parse_params(cursor, result)) return std::nullopt;
+            params = true;
+        }
+        else if(not cursor.skip_value())
+        {
+            return std::nullopt;
+        }
+    } while(cursor.consume(','));
+
+    if(not cursor.consume('}') or not props or not params) return std::nullopt;
+    return result;
+}
+
+void apply_change(DeviceState& state, const PropertyChange& change)
+{
+    if(change.power) state.powered = *change.power;
+    if(change.brightness) state.brightness = *change.brightness;
+    if(change.rgb) state.rgb = *change.rgb;
+    if(change.temperature) state.temperature = *change.temperature;
+    if(change.hue) state.hue = *change.hue;
+    if(change.saturation) state.saturation = *change.saturation;
+    if(change.flowing) state.flowing = *change.flowing;
+
+    const auto mode = change.mode.value_or(0);
+    if(mode >= 1 and mode <= 3) state.mode = static_cast<color_mode>(mode);
+
+    if(change.name) state.name = unescape(*change.name);
+}
+
+std::optional<Property> find_property(std::string_view name)
+{
+    const auto iter = std::find(property_names.begin(), property_names.end(), name);
+    if(iter == property_names.end()) return std::nullopt;
+    return static_cast<Property>(iter - property_names.begin());
+}
+
+void set_property(PropertyChange& change, Property property, std::string_view value)
+{
+    switch(property)
+    {
+    case Property::power:
+        if(value == "on") change.power = true;
+        else if(value == "off") change.power = false;
+        break;
+    case Property::bright: change.brightness = parse_number(value); break;
+    case Property::color_mode: change.mode = parse_number(value); break;
+    case Property::ct: change.temperature = parse_number(value); break;
+    case Property::rgb: change.rgb = parse_number(value); break;
+    case Property::hue: change.hue = parse_number(value); break;
+    case Property::sat: change.saturation = parse_number(value); break;
+    case Property::flowing:
+        if(const auto flowing = parse_number(value)) change.flowing = *flowing != 0;
+        break;
+    case Property::name: change.name = value; break;
+    case Property::count: break;
+    }
+}
+
+PropertySet present(const PropertyChange& change)
+{
+    PropertySet result;
+    result.set(static_cast<size_t>(Property::power), change.power.has_value());
+    result.set(static_cast<size_t>(Property::bright), change.brightness.has_value());
+    result.set(static_cast<size_t>(Property::color_mode), change.mode.has_value());
+    result.set(static_cast<size_t>(Property::ct), change.temperature.has_value());
+    result.set(static_cast<size_t>(Property::rgb), change.rgb.has_value());
+    result.set(static_cast<size_t>(Property::hue), change.hue.has_value());
+    result.set(static_cast<size_t>(Property::sat), change.saturation.has_value());
+    result.set(static_cast<size_t>(Property::flowing), change.flowing.has_value());
+    result.set(static_cast<size_t>(Property::name), change.name.has_value());
+    return result;
+}
+
+} // namespace yeelight
@@ -0,0 +1,81 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/18/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <initializer_list>
+#include <optional>
+#include <string_view>
+
+#include "util.h"
+
+namespace yeelight
+{
+
+// the properties we can ask for with get_prop
+enum class Property
+{
+    power,
+    bright,
+    color_mode,
+    ct,
+    rgb,
+    hue,
+    sat,
+    flowing,
+    name,
+    count,
+};
+
+using PropertySet = std::bitset<static_cast<size_t>(Property::count)>;
+
+constexpr std::array<std::string_view, static_cast<size_t>(Property::count)> property_names
+= { "power", "bright", "color_mode", "ct", "rgb", "hue", "sat", "flowing", "name" };
+
+inline PropertySet make_properties(std::initializer_list<Property> properties)
+{
+    PropertySet result;
+    for(const auto property : properties) result.set(static_cast<size_t>(property));
+    return result;
+}
+
+// What changed according to a props notification, the bulb sends one of these
+// to every connection whenever its state changes, from the app or a switch.
+// The name is a view into the message, escapes and all.
+struct PropertyChange
+{
+    std::optional<bool>     power;
+    std::optional<uint32_t> brightness;
+    std::optional<uint32_t> mode;
+    std::optional<uint32_t> rgb;
+    std::optional<uint32_t> temperature;
+    std::optional<uint32_t> hue;
+    std::optional<uint32_t> saturation;
+    std::optional<bool>     flowing;
+
+    std::optional<std::string_view> name;
+};
+
+// {"method":"props","params":{"power":"on","bright":"10"}} in a single pass
+// without building a document, returns nothing for anything else
+std::optional<PropertyChange> parse_notification(std::string_view message);
+
+// overwrites the fields of the state that were in the notification
+void apply_change(DeviceState& state, const PropertyChange& change);
+
+std::optional<Property> find_property(std::string_view name);
+
+// fills in one field from the value as the bulb writes it, the name is expected to be escaped
+void set_property(PropertyChange& change, Property property, std::string_view value);
+
+// the fields that the change has
+PropertySet present(const PropertyChange& change);
+
+} // namespace yeelight
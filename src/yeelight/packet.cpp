@@ -0,0 +1,72 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/9/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "packet.h"
+
+#include <cstring>
+
+namespace yeelight
+{
+
+uint16_t ones_complement_sum(const unsigned char* data, size_t size)
+{
+    // The sum does not depend on the byte order of the words (rfc 1071), so we add
+    // them in native order and swap once at the end. Adding whole 32 bit words into
+    // a wide accumulator has no carries to fold inside the loop, which lets the
+    // compiler vectorize it.
+    uint64_t sum   = 0;
+    size_t   index = 0;
+
+    for(; index + 4 <= size; index += 4)
+    {
+        uint32_t word;
+        std::memcpy(&word, data + index, 4);
+        sum += word;
+    }
+
+    // the leftover bytes, an odd byte is padded with a zero
+    unsigned char rest[4] = {};
+    std::memcpy(rest, data + index, size - index);
+
+    uint32_t word;
+    std::memcpy(&word, rest, 4);
+    sum += word;
+
+    while(sum >> 16) sum = (sum & 0xFFFF) + (sum >> 16);
+    auto result = static_cast<uint16_t>(sum);
+
+#if __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    result = static_cast<uint16_t>((result >> 8) | (result << 8));
+#endif
+    return result;
+}
+
+std::optional<Ipv4View> Ipv4View::parse(const unsigned char* data, size_t size)
+{
+    if(size < 20) return std::nullopt;
+
+    const auto view = Ipv4View(data, size);
+    if(view.version() != 4) return std::nullopt;
+    if(view.header_length() < 20 or view.header_length() > size) return std::nullopt;
+
+    // only look at what was actually received, even if the header claims more
+    if(view.total_length() < view.header_length()) return std::nullopt;
+    if(view.total_length() < size) return Ipv4View(data, view.total_length());
+
+    return view;
+}
+
+std::optional<IcmpView> IcmpView::parse(const unsigned char* data, size_t size)
+{
+    if(size < header_size) return std::nullopt;
+
+    // the sum over a message including its checksum is all ones when it is intact
+    if(ones_complement_sum(data, size) != 0xFFFF) return std::nullopt;
+
+    return IcmpView(data, size);
+}
+
+} // namespace yeelight
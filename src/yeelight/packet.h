@@ -0,0 +1,82 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/9/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <boost/asio/ip/address_v4.hpp>
+#include <cstdint>
+#include <optional>
+
+namespace yeelight
+{
+
+// the internet checksum sum of the bytes, in network order
+uint16_t ones_complement_sum(const unsigned char* data, size_t size);
+
+// Read only views over received packets, these decode straight from the
+// receive buffer instead of copying into an ipv4_header or icmp_header.
+// The views do not own anything, the buffer has to outlive them.
+class Ipv4View
+{
+    public:
+    // nothing if the bytes do not start with a complete and valid header
+    static std::optional<Ipv4View> parse(const unsigned char* data, size_t size);
+
+    [[nodiscard]] unsigned char  version() const { return data[0] >> 4; }
+    [[nodiscard]] size_t         header_length() const { return (data[0] & 0xF) * 4; }
+    [[nodiscard]] unsigned short total_length() const { return decode(2); }
+    [[nodiscard]] unsigned char  protocol() const { return data[9]; }
+
+    [[nodiscard]] boost::asio::ip::address_v4 source_address() const
+    {
+        return boost::asio::ip::address_v4({ data[12], data[13], data[14], data[15] });
+    }
+
+    [[nodiscard]] const unsigned char* payload() const { return data + header_length(); }
+    [[nodiscard]] size_t payload_size() const { return size - header_length(); }
+
+    private:
+    Ipv4View(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    [[nodiscard]] unsigned short decode(size_t index) const
+    {
+        return static_cast<unsigned short>((data[index] << 8) + data[index + 1]);
+    }
+
+    const unsigned char* data;
+    size_t               size;
+};
+
+class IcmpView
+{
+    public:
+    // nothing if the message is too short or the checksum is wrong
+    static std::optional<IcmpView> parse(const unsigned char* data, size_t size);
+
+    [[nodiscard]] unsigned char  type() const { return data[0]; }
+    [[nodiscard]] unsigned char  code() const { return data[1]; }
+    [[nodiscard]] unsigned short identifier() const { return decode(4); }
+    [[nodiscard]] unsigned short sequence_number() const { return decode(6); }
+
+    [[nodiscard]] const unsigned char* body() const { return data + header_size; }
+    [[nodiscard]] size_t body_size() const { return size - header_size; }
+
+    constexpr static size_t header_size = 8;
+
+    private:
+    IcmpView(const unsigned char* data, size_t size) : data(data), size(size) {}
+
+    [[nodiscard]] unsigned short decode(size_t index) const
+    {
+        return static_cast<unsigned short>((data[index] << 8) + data[index + 1]);
+    }
+
+    const unsigned char* data;
+    size_t               size;
+};
+
+} // namespace yeelight
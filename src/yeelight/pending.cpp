@@ -0,0 +1,103 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/4/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "pending.h"
+
+namespace yeelight
+{
+
+PendingTable::PendingTable(size_t capacity) : slots()
+{
+    // keep the size a power of two so the slot is a mask of the id
+    size_t size = 1;
+    while(size < capacity) size *= 2;
+    slots.resize(size);
+}
+
+void PendingTable::insert(uint64_t id, clock::duration timeout, ResponseCallback callback)
+{
+    while(slots[id & (slots.size() - 1)].id != 0) grow();
+
+    const auto now = clock::now();
+    auto&      slot = slots[id & (slots.size() - 1)];
+
+    slot.id       = id;
+    slot.sent     = now;
+    slot.deadline = now + timeout;
+    slot.callback = std::move(callback);
+    count++;
+}
+
+bool PendingTable::complete(uint64_t id, Error error, nlohmann::json result)
+{
+    auto& slot = slots[id & (slots.size() - 1)];
+    if(id == 0 or slot.id != id) return false;
+
+    auto [callback, response] = take(slot, error, std::move(result), clock::now());
+    if(callback != nullptr) callback(response);
+    return true;
+}
+
+size_t PendingTable::expire(clock::time_point now)
+{
+    // callbacks may send new requests and grow the table, so call them afterwards
+    std::vector<std::pair<ResponseCallback, Response>> expired;
+    for(auto& slot : slots)
+    {
+        if(slot.id != 0 and slot.deadline <= now)
+            expired.emplace_back(take(slot, Error::timeout, nullptr, now));
+    }
+
+    for(const auto& [callback, response] : expired)
+    {
+        if(callback != nullptr) callback(response);
+    }
+    return expired.size();
+}
+
+void PendingTable::fail_all(Error error)
+{
+    const auto now = clock::now();
+
+    std::vector<std::pair<ResponseCallback, Response>> failed;
+    for(auto& slot : slots)
+    {
+        if(slot.id != 0) failed.emplace_back(take(slot, error, nullptr, now));
+    }
+
+    for(const auto& [callback, response] : failed)
+    {
+        if(callback != nullptr) callback(response);
+    }
+}
+
+void PendingTable::grow()
+{
+    std::vector<Slot> old(slots.size() * 2);
+    old.swap(slots);
+
+    // the ids in the old table are unique, so they can not collide after doubling
+    for(auto& slot : old)
+    {
+        if(slot.id != 0) slots[slot.id & (slots.size() - 1)] = std::move(slot);
+    }
+}
+
+std::pair<ResponseCallback, Response>
+PendingTable::take(Slot& slot, Error error, nlohmann::json result, clock::time_point now)
+{
+    auto response = Response{ slot.id, error, std::move(result), now - slot.sent };
+    auto callback = std::move(slot.callback);
+
+    // free the slot before calling back, the callback might send a new request
+    slot.id       = 0;
+    slot.callback = nullptr;
+    count--;
+
+    return { std::move(callback), std::move(response) };
+}
+
+} // namespace yeelight
@@ -0,0 +1,86 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/4/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.h>
+
+namespace yeelight
+{
+
+enum class Error
+{
+    none,
+    not_connected,
+    timeout,
+    rejected,
+    superseded,
+};
+
+struct Response
+{
+    uint64_t id;
+    Error    error;
+
+    // the "result" array on success, the "error" object when rejected
+    nlohmann::json result;
+
+    std::chrono::steady_clock::duration latency;
+};
+
+using ResponseCallback = std::function<void(const Response&)>;
+
+// All requests that were sent but not answered yet, so many can be in flight
+// on the same socket. Ids are handed out sequentially, so the slot of an id is
+// simply its lower bits, the table only grows when that slot is still taken.
+class PendingTable
+{
+    public:
+    using clock = std::chrono::steady_clock;
+
+    explicit PendingTable(size_t capacity = initial_capacity);
+
+    void insert(uint64_t id, clock::duration timeout, ResponseCallback callback);
+
+    // completes the request with the bulb's answer, false if the id is unknown
+    bool complete(uint64_t id, Error error, nlohmann::json result);
+
+    // completes every request whose deadline passed with a timeout, returns how many
+    size_t expire(clock::time_point now = clock::now());
+
+    // completes every request with the same error, for when the connection is lost
+    void fail_all(Error error);
+
+    [[nodiscard]] bool   empty() const { return count == 0; }
+    [[nodiscard]] size_t size() const { return count; }
+
+    private:
+    struct Slot
+    {
+        uint64_t          id = 0; // zero means free, message ids start at one
+        clock::time_point sent;
+        clock::time_point deadline;
+        ResponseCallback  callback;
+    };
+
+    void grow();
+
+    std::pair<ResponseCallback, Response>
+    take(Slot& slot, Error error, nlohmann::json result, clock::time_point now);
+
+    std::vector<Slot> slots;
+    size_t            count = 0;
+
+    constexpr static size_t initial_capacity = 16;
+};
+
+} // namespace yeelight
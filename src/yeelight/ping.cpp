@@ -0,0 +1,209 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/8/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "ping.h"
+#include "packet.h"
+
+#include <boost-icmp/icmp_header.hpp>
+
+#include <cstring>
+#include <iostream>
+#include <netinet/in.h>
+#include <unistd.h>
+
+namespace
+{
+void encode(unsigned char* data, uint16_t value)
+{
+    data[0] = static_cast<unsigned char>(value >> 8);
+    data[1] = static_cast<unsigned char>(value & 0xFF);
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+PingService::PingService(std::shared_ptr<boost::asio::io_context> context, std::chrono::milliseconds interval)
+: context(std::move(context)), strand(boost::asio::make_strand(*this->context)), mutex(),
+  socket(strand), timer(strand), interval(interval),
+  entries(), free_entries(), buffer(), base(static_cast<uint16_t>(::getpid())), rounds()
+{
+    // raw sockets need CAP_NET_RAW, without it every device is just assumed to be up
+    boost::system::error_code error;
+    socket.open(boost::asio::ip::icmp::v4(), error);
+
+    if(error)
+    {
+        std::cout << "cannot open icmp socket: " << error.message() << ", pinging disabled\n";
+        return;
+    }
+
+    start_receive();
+    start_timer();
+}
+
+PingService::Handle PingService::subscribe(boost::asio::ip::address_v4 address, Subscriber callback)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    Handle handle;
+    if(free_entries.empty())
+    {
+        handle = entries.size();
+        entries.emplace_back();
+    }
+    else
+    {
+        handle = free_entries.back();
+        free_entries.pop_back();
+    }
+
+    auto& entry    = entries[handle];
+    entry.endpoint = boost::asio::ip::icmp::endpoint(address, 0);
+    entry.sequence = 0;
+    entry.awaiting = false;
+    entry.active   = true;
+    entry.liveness = Liveness();
+    entry.callback = std::move(callback);
+
+    // everything except the sequence number and checksum stays the same forever
+    entry.request.fill(0);
+    entry.request[0] = icmp_header::echo_request;
+    entry.request[1] = 0;
+    encode(entry.request.data() + 4, static_cast<uint16_t>(base + handle));
+    std::memcpy(entry.request.data() + header_size, body, body_size);
+
+    return handle;
+}
+
+void PingService::unsubscribe(Handle handle)
+{
+    const auto lock = std::lock_guard(mutex);
+
+    auto& entry    = entries.at(handle);
+    entry.active   = false;
+    entry.callback = nullptr;
+    free_entries.emplace_back(handle);
+}
+
+Liveness PingService::liveness(Handle handle) const
+{
+    const auto lock = std::lock_guard(mutex);
+    return entries.at(handle).liveness;
+}
+
+void PingService::set_listener(Subscriber callback)
+{
+    const auto lock = std::lock_guard(mutex);
+    listener        = std::move(callback);
+}
+
+void PingService::start_timer()
+{
+    const auto handler = [this](auto error) {
+        if(error) return;
+
+        send_all();
+        start_timer();
+    };
+
+    timer.expires_from_now(boost::posix_time::milliseconds(interval.count()));
+    timer.async_wait(handler);
+}
+
+void PingService::send_all()
+{
+    const auto lock = std::lock_guard(mutex);
+    const auto now = std::chrono::steady_clock::now();
+
+    // the round before last is still being sent, the network is so backed up that another one would not help
+    auto& current = rounds[round % rounds.size()];
+    if(current.sending != 0) return;
+    round++;
+
+    // sized before any send, so the packets do not move while they are in flight
+    current.packets.resize(entries.size() * request_size);
+
+    for(size_t i = 0; i < entries.size(); i++)
+    {
+        auto& entry = entries[i];
+        if(not entry.active) continue;
+
+        // the previous round was never answered
+        if(entry.awaiting)
+        {
+            entry.liveness.lost_in_row++;
+            if(entry.liveness.lost_in_row >= down_after) update(entry, false);
+        }
+
+        entry.sequence++;
+        entry.awaiting = true;
+        entry.sent     = now;
+        entry.liveness.sent++;
+
+        const auto packet = current.packets.data() + i * request_size;
+        std::memcpy(packet, entry.request.data(), request_size);
+        encode(packet + 6, entry.sequence);
+        encode(packet + 2, static_cast<uint16_t>(~ones_complement_sum(packet, request_size)));
+
+        // the only thing that can fail is the network itself, which shows up as a lost reply
+        current.sending++;
+        socket.async_send_to(boost::asio::buffer(packet, request_size), entry.endpoint,
+                             [&current](auto, auto) { current.sending--; });
+    }
+}
+
+void PingService::start_receive()
+{
+    const auto handler = [this](auto error, auto bytes) {
+        if(error == boost::asio::error::operation_aborted) return;
+        if(not error) handle_reply(bytes);
+
+        start_receive();
+    };
+
+    socket.async_receive(boost::asio::buffer(buffer), handler);
+}
+
+void PingService::handle_reply(size_t bytes)
+{
+    const auto ipv4 = Ipv4View::parse(buffer.data(), bytes);
+    if(not ipv4 or ipv4->protocol() != IPPROTO_ICMP) return;
+
+    const auto icmp = IcmpView::parse(ipv4->payload(), ipv4->payload_size());
+    if(not icmp or icmp->type() != icmp_header::echo_reply) return;
+
+    const auto lock   = std::lock_guard(mutex);
+    const auto handle = static_cast<uint16_t>(icmp->identifier() - base);
+    if(handle >= entries.size()) return;
+
+    auto& entry = entries[handle];
+    if(not entry.active or not entry.awaiting) return;
+    if(icmp->sequence_number() != entry.sequence) return;
+    if(ipv4->source_address() != entry.endpoint.address().to_v4()) return;
+
+    const auto rtt = std::chrono::steady_clock::now() - entry.sent;
+    auto&      liveness = entry.liveness;
+
+    liveness.rtt = liveness.received == 0 ? rtt : (liveness.rtt * 7 + rtt) / 8;
+    liveness.received++;
+    liveness.lost_in_row = 0;
+
+    entry.awaiting = false;
+    update(entry, true);
+}
+
+void PingService::update(Entry& entry, bool up)
+{
+    if(entry.liveness.up == up) return;
+
+    entry.liveness.up = up;
+    if(entry.callback != nullptr) entry.callback(up);
+    if(listener != nullptr) listener(up);
+}
+
+} // namespace yeelight
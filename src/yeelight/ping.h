@@ -0,0 +1,124 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/8/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <array>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace yeelight
+{
+
+struct Liveness
+{
+    std::chrono::steady_clock::duration rtt = {}; // smoothed over the last replies
+
+    uint64_t sent        = 0;
+    uint64_t received    = 0;
+    uint64_t lost_in_row = 0;
+
+    bool up = true;
+};
+
+// Checks if devices are still on the network with a single raw icmp socket
+// for all of them. Every device gets its own echo identifier, the requests
+// are encoded once and only the sequence number and checksum change per round.
+// Subscribers are called from the service's strand, they should not block.
+class PingService
+{
+    public:
+    using Handle     = size_t;
+    using Subscriber = std::function<void(bool up)>;
+
+    explicit PingService(std::shared_ptr<boost::asio::io_context> context,
+                         std::chrono::milliseconds                interval = default_interval);
+
+    PingService(const PingService&) = delete;
+
+    PingService operator=(const PingService&) = delete;
+
+    // the callback is called every time the device goes up or down
+    Handle subscribe(boost::asio::ip::address_v4 address, Subscriber callback);
+
+    void unsubscribe(Handle handle);
+
+    [[nodiscard]] Liveness liveness(Handle handle) const;
+
+    // called on top of the subscriber whenever any device goes up or down
+    void set_listener(Subscriber callback);
+
+    private:
+    constexpr static size_t header_size  = 8;
+    constexpr static size_t body_size    = 5;
+    constexpr static size_t request_size = header_size + body_size;
+
+    struct Entry
+    {
+        boost::asio::ip::icmp::endpoint endpoint;
+        std::array<unsigned char, request_size> request; // the template, the sequence and checksum are filled in per send
+
+        std::chrono::steady_clock::time_point sent;
+        uint16_t sequence = 0;
+        bool     awaiting = false;
+        bool     active   = false;
+
+        Liveness   liveness;
+        Subscriber callback;
+    };
+
+    void start_timer();
+
+    void send_all();
+
+    void start_receive();
+
+    void handle_reply(size_t bytes);
+
+    void update(Entry& entry, bool up);
+
+    // The requests of a round are written next to each other and stay there until they are sent.
+    // The buffers are reused round after round, so they only grow when devices are added.
+    struct Round
+    {
+        std::vector<unsigned char> packets;
+        size_t                     sending = 0; // sends that did not complete yet
+    };
+
+    std::shared_ptr<boost::asio::io_context>                     context;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
+
+    // guards the entries, subscribing happens from other threads
+    mutable std::mutex mutex;
+
+    boost::asio::ip::icmp::socket socket;
+    boost::asio::deadline_timer   timer;
+
+    std::chrono::milliseconds interval;
+
+    Subscriber listener;
+
+    std::vector<Entry>              entries; // the echo identifier is base + index
+    std::vector<Handle>             free_entries;
+    std::array<unsigned char, 1500> buffer;
+    uint16_t                        base;
+
+    // only used on the strand
+    std::array<Round, 2> rounds;
+    uint64_t             round = 0;
+
+    constexpr static auto   default_interval = std::chrono::milliseconds(3000);
+    constexpr static size_t down_after       = 2; // lost replies in a row
+    constexpr static auto   body             = "Silky";
+};
+
+} // namespace yeelight
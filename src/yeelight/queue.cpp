@@ -0,0 +1,111 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/5/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "queue.h"
+
+#include <algorithm>
+#include <utility>
+
+namespace yeelight
+{
+
+CommandQueue::CommandQueue(double rate, double burst)
+: commands(), stats(), rate(rate), burst(burst), tokens(burst), last_refill(clock::now())
+{
+}
+
+std::optional<Command> CommandQueue::push(Command command)
+{
+    if(command.coalesce)
+    {
+        const auto same = [&](const auto& elem) { return elem.method == command.method; };
+        const auto iter = std::find_if(commands.begin(), commands.end(), same);
+
+        if(iter != commands.end())
+        {
+            // keep the position in line, only the newest parameters matter
+            command.throttled = iter->throttled;
+            std::swap(*iter, command);
+            stats.coalesced.fetch_add(1, std::memory_order_relaxed);
+            return command;
+        }
+    }
+
+    commands.emplace_back(std::move(command));
+    return std::nullopt;
+}
+
+std::optional<Command> CommandQueue::pop(clock::time_point now)
+{
+    if(commands.empty()) return std::nullopt;
+
+    refill(now);
+    if(tokens < 1)
+    {
+        if(not commands.front().throttled) stats.throttled.fetch_add(1, std::memory_order_relaxed);
+        commands.front().throttled = true;
+        return std::nullopt;
+    }
+
+    tokens -= 1;
+    stats.sent.fetch_add(1, std::memory_order_relaxed);
+
+    auto command = std::move(commands.front());
+    commands.pop_front();
+    return command;
+}
+
+std::optional<Command> CommandQueue::take(std::string_view method)
+{
+    const auto same = [&](const auto& elem) { return elem.coalesce and elem.method == method; };
+    const auto iter = std::find_if(commands.begin(), commands.end(), same);
+    if(iter == commands.end()) return std::nullopt;
+
+    auto command = std::move(*iter);
+    commands.erase(iter);
+    stats.coalesced.fetch_add(1, std::memory_order_relaxed);
+    return command;
+}
+
+void CommandQueue::consume(clock::time_point now)
+{
+    refill(now);
+    tokens = std::max(0.0, tokens - 1);
+    stats.sent.fetch_add(1, std::memory_order_relaxed);
+}
+
+QueueStatistics CommandQueue::statistics() const
+{
+    QueueStatistics result;
+    result.sent      = stats.sent.load(std::memory_order_relaxed);
+    result.coalesced = stats.coalesced.load(std::memory_order_relaxed);
+    result.throttled = stats.throttled.load(std::memory_order_relaxed);
+    return result;
+}
+
+CommandQueue::clock::time_point CommandQueue::next_token(clock::time_point now) const
+{
+    const auto elapsed = std::chrono::duration<double>(now - last_refill).count();
+    const auto current = std::min(burst, tokens + elapsed * rate);
+    if(current >= 1) return now;
+
+    const auto wait = std::chrono::duration<double>((1 - current) / rate);
+    return now + std::chrono::duration_cast<clock::duration>(wait);
+}
+
+std::deque<Command> CommandQueue::clear()
+{
+    return std::exchange(commands, {});
+}
+
+void CommandQueue::refill(clock::time_point now)
+{
+    const auto elapsed = std::chrono::duration<double>(now - last_refill).count();
+    tokens             = std::min(burst, tokens + elapsed * rate);
+    last_refill        = now;
+}
+
+} // namespace yeelight
@@ -0,0 +1,97 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/5/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <optional>
+#include <string>
+#include <string_view>
+
+#include "pending.h"
+
+namespace yeelight
+{
+
+// made with make_command from schema.h
+struct Command
+{
+    std::string_view method; // one of the names in the schema, they live forever
+    std::string      params; // the serialized json array
+
+    ResponseCallback callback;
+    bool             coalesce  = false; // see Method
+    bool             throttled = false;
+};
+
+struct QueueStatistics
+{
+    uint64_t sent      = 0;
+    uint64_t coalesced = 0; // replaced by a newer command of the same method
+    uint64_t throttled = 0; // had to wait for a token before being sent
+};
+
+// The bulb silently drops everything above its quota of 60 commands a minute.
+// This queue keeps us below it with a token bucket and makes sure the latest
+// state always arrives, by replacing queued setters with newer ones.
+class CommandQueue
+{
+    public:
+    using clock = std::chrono::steady_clock;
+
+    explicit CommandQueue(double rate = default_rate, double burst = default_burst);
+
+    // queues the command, or replaces the queued one with the same method if
+    // that method only sets state, the replaced command is returned
+    std::optional<Command> push(Command command);
+
+    // the next command if there is a token for it
+    std::optional<Command> pop(clock::time_point now = clock::now());
+
+    // removes the queued command with this method if it coalesces, if there is one
+    std::optional<Command> take(std::string_view method);
+
+    // uses a token for a command that does not wait in line, it does not go below zero
+    void consume(clock::time_point now = clock::now());
+
+    // when the next token will be available, now if there already is one
+    [[nodiscard]] clock::time_point next_token(clock::time_point now = clock::now()) const;
+
+    // empties the queue and returns what was in it
+    std::deque<Command> clear();
+
+    [[nodiscard]] bool empty() const { return commands.empty(); }
+
+    // the only member that can be read from any thread, the rest belongs to the device's strand
+    [[nodiscard]] QueueStatistics statistics() const;
+
+    private:
+    struct Counters
+    {
+        std::atomic<uint64_t> sent      = 0;
+        std::atomic<uint64_t> coalesced = 0;
+        std::atomic<uint64_t> throttled = 0;
+    };
+
+    void refill(clock::time_point now);
+
+    std::deque<Command> commands;
+    Counters            stats;
+
+    double            rate;
+    double            burst;
+    double            tokens;
+    clock::time_point last_refill;
+
+    // 48 a minute plus a burst of 10 stays under the quota in any minute
+    constexpr static double default_rate  = 0.8;
+    constexpr static double default_burst = 10;
+};
+
+} // namespace yeelight
@@ -0,0 +1,77 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/3/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "reader.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace yeelight
+{
+
+LineReader::LineReader(size_t capacity) : data(std::max(capacity, minimum_free)) {}
+
+boost::asio::mutable_buffer LineReader::prepare()
+{
+    if(data.size() - end >= minimum_free) return boost::asio::buffer(data.data() + end, data.size() - end);
+
+    // first try to make room by dropping the lines that were already handed out
+    if(begin != 0)
+    {
+        std::memmove(data.data(), data.data() + begin, end - begin);
+        scan -= begin;
+        end -= begin;
+        begin = 0;
+    }
+
+    if(data.size() - end < minimum_free)
+    {
+        // a single line this big is not something a bulb sends, so it is garbage
+        if(data.size() * 2 > maximum_capacity) clear();
+        else data.resize(data.size() * 2);
+    }
+    return boost::asio::buffer(data.data() + end, data.size() - end);
+}
+
+void LineReader::commit(size_t bytes)
+{
+    end = std::min(end + bytes, data.size());
+}
+
+std::optional<std::string_view> LineReader::next()
+{
+    // the '\r' of a delimiter may already have been scanned in a previous call
+    const auto start = std::max(begin, scan == 0 ? scan : scan - 1);
+    const auto view  = std::string_view(data.data() + start, end - start);
+
+    const auto index = view.find("\r\n");
+    if(index == std::string_view::npos)
+    {
+        scan = end;
+        return std::nullopt;
+    }
+
+    const auto line_end = start + index;
+    const auto result   = std::string_view(data.data() + begin, line_end - begin);
+
+    begin = line_end + 2;
+    scan  = begin;
+
+    if(begin == end)
+    {
+        // cheap reset so the next receive starts at the front again
+        // this is safe because prepare() is the only thing that invalidates the view
+        begin = scan = end = 0;
+    }
+    return result;
+}
+
+void LineReader::clear()
+{
+    begin = scan = end = 0;
+}
+
+} // namespace yeelight
@@ -0,0 +1,55 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/3/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <boost/asio/buffer.hpp>
+#include <optional>
+#include <string_view>
+#include <vector>
+
+namespace yeelight
+{
+
+// The bulb sends its replies as "\r\n" terminated json objects, but tcp does
+// not care about that: one receive can hold several replies or half of one.
+// This reader keeps the bytes that were not framed yet and hands out every
+// complete line as a view into its own storage, so nothing gets copied.
+class LineReader
+{
+    public:
+    explicit LineReader(size_t capacity = initial_capacity);
+
+    // returns the free space after the unread data, the receive goes there
+    // this moves the partial line to the front and grows when it is full
+    boost::asio::mutable_buffer prepare();
+
+    // marks the first bytes of the prepared buffer as received
+    void commit(size_t bytes);
+
+    // the next complete line without its delimiter, or nothing if there is none
+    // the view stays valid until the next call to prepare()
+    std::optional<std::string_view> next();
+
+    // forget everything, used when the connection is reset
+    void clear();
+
+    [[nodiscard]] size_t pending() const { return end - begin; }
+
+    private:
+    std::vector<char> data;
+
+    size_t begin = 0; // start of the first line that was not handed out yet
+    size_t scan  = 0; // everything before this was checked for a delimiter
+    size_t end   = 0; // end of the received data
+
+    constexpr static size_t initial_capacity = 1024;
+    constexpr static size_t minimum_free     = 256;
+    constexpr static size_t maximum_capacity = 64 * 1024;
+};
+
+} // namespace yeelight
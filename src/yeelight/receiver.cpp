@@ -0,0 +1,147 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/23/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "receiver.h"
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+namespace yeelight
+{
+
+DatagramBatch::DatagramBatch(size_t count, size_t size)
+: count(count), size(size), storage(count * size), lengths(count), senders(count)
+{
+#ifdef __linux__
+    headers.resize(count);
+    vectors.resize(count);
+#endif
+}
+
+BufferPool::BufferPool(size_t batch, size_t size) : mutex(), free_batches(), batch(std::max<size_t>(batch, 1)), size(size) {}
+
+std::unique_ptr<DatagramBatch> BufferPool::acquire()
+{
+    const auto lock = std::lock_guard(mutex);
+    if(free_batches.empty()) return std::make_unique<DatagramBatch>(batch, size);
+
+    auto result = std::move(free_batches.back());
+    free_batches.pop_back();
+    return result;
+}
+
+void BufferPool::release(std::unique_ptr<DatagramBatch> released)
+{
+    if(released == nullptr) return;
+
+    const auto lock = std::lock_guard(mutex);
+    free_batches.emplace_back(std::move(released));
+}
+
+DatagramReceiver::DatagramReceiver(boost::asio::ip::udp::socket& socket, BufferPool& pool, Handler handler)
+: socket(socket), pool(pool), batch(pool.acquire()), handler(std::move(handler))
+{
+}
+
+DatagramReceiver::~DatagramReceiver()
+{
+    pool.release(std::move(batch));
+}
+
+void DatagramReceiver::start()
+{
+    // we only read what is already there, waiting is left to the executor
+    socket.non_blocking(true);
+    wait();
+}
+
+size_t DatagramReceiver::receive(boost::system::error_code& error)
+{
+#ifdef __linux__
+    for(size_t i = 0; i < batch->count; i++)
+    {
+        batch->vectors[i]  = iovec{ batch->slot(i), batch->size };
+        auto& header       = batch->headers[i].msg_hdr;
+        header             = msghdr();
+        header.msg_name    = batch->senders[i].data();
+        header.msg_namelen = static_cast<socklen_t>(batch->senders[i].capacity());
+        header.msg_iov     = &batch->vectors[i];
+        header.msg_iovlen  = 1;
+    }
+
+    const auto received = ::recvmmsg(socket.native_handle(), batch->headers.data(), batch->count, MSG_DONTWAIT, nullptr);
+    if(received < 0)
+    {
+        error = boost::system::error_code(errno, boost::asio::error::get_system_category());
+        return 0;
+    }
+
+    for(size_t i = 0; i < static_cast<size_t>(received); i++)
+    {
+        batch->senders[i].resize(batch->headers[i].msg_hdr.msg_namelen);
+        batch->lengths[i] = std::min<size_t>(batch->headers[i].msg_len, batch->size);
+    }
+    return static_cast<size_t>(received);
+#else
+    size_t received = 0;
+    while(received < batch->count)
+    {
+        const auto buffer = boost::asio::buffer(batch->slot(received), batch->size);
+        const auto bytes  = socket.receive_from(buffer, batch->senders[received], 0, error);
+        if(error) break;
+
+        batch->lengths[received++] = bytes;
+    }
+
+    // what we got is fine, the error shows up again on the next read
+    if(received != 0) error = boost::system::error_code();
+    return received;
+#endif
+}
+
+bool DatagramReceiver::stopped(const boost::system::error_code& error) const
+{
+    return error == boost::asio::error::operation_aborted or error == boost::asio::error::bad_descriptor
+           or not socket.is_open();
+}
+
+void DatagramReceiver::wait()
+{
+    const auto readable = [this](const auto& error) {
+        if(stopped(error)) return;
+        if(error) std::cout << "waiting for datagrams: " << error.message() << '\n';
+
+        for(size_t round = 0; round < max_batches; round++)
+        {
+            boost::system::error_code receive_error;
+            const auto                received = receive(receive_error);
+
+            for(size_t i = 0; i < received; i++)
+            {
+                handler(Datagram{ std::string_view(batch->slot(i), batch->lengths[i]), batch->senders[i] });
+            }
+
+            if(receive_error == boost::asio::error::would_block or receive_error == boost::asio::error::try_again) break;
+            if(stopped(receive_error)) return;
+
+            // like a refused port from an earlier send, the next datagram may well be fine
+            if(receive_error)
+            {
+                std::cout << "receiving datagrams: " << receive_error.message() << '\n';
+                break;
+            }
+
+            // a batch that was not full drained the socket
+            if(received < batch->count) break;
+        }
+        wait();
+    };
+
+    socket.async_wait(boost::asio::ip::udp::socket::wait_read, readable);
+}
+
+} // namespace yeelight
@@ -0,0 +1,110 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/23/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string_view>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+#ifdef __linux__
+#include <sys/socket.h>
+#endif
+
+namespace yeelight
+{
+
+struct Datagram
+{
+    std::string_view               data;
+    boost::asio::ip::udp::endpoint sender;
+};
+
+// Room for a batch of datagrams, read from the socket in one go.
+struct DatagramBatch
+{
+    DatagramBatch(size_t count, size_t size);
+
+    [[nodiscard]] char* slot(size_t index) { return storage.data() + index * size; }
+
+    size_t count;
+    size_t size;
+
+    std::vector<char>                           storage; // count slots of size bytes
+    std::vector<size_t>                         lengths;
+    std::vector<boost::asio::ip::udp::endpoint> senders;
+
+#ifdef __linux__
+    // what recvmmsg fills in, pointing into the storage and senders above
+    std::vector<mmsghdr> headers;
+    std::vector<iovec>   vectors;
+#endif
+};
+
+// Hands out receive buffers, so every socket reads into memory of its own.
+// Batches that are given back are reused, it can be used from any thread.
+class BufferPool
+{
+    public:
+    explicit BufferPool(size_t batch = default_batch, size_t size = default_size);
+
+    std::unique_ptr<DatagramBatch> acquire();
+
+    void release(std::unique_ptr<DatagramBatch> batch);
+
+    private:
+    std::mutex                                  mutex;
+    std::vector<std::unique_ptr<DatagramBatch>> free_batches;
+
+    size_t batch;
+    size_t size;
+
+    constexpr static size_t default_batch = 16;
+    constexpr static size_t default_size  = 1024;
+};
+
+// Reads every datagram that is waiting on a socket each time it becomes readable,
+// with a single recvmmsg per batch on linux and one receive per datagram elsewhere.
+// The handler is called from the socket's executor, the data only lives until it returns.
+class DatagramReceiver
+{
+    public:
+    using Handler = std::function<void(const Datagram&)>;
+
+    DatagramReceiver(boost::asio::ip::udp::socket& socket, BufferPool& pool, Handler handler);
+
+    ~DatagramReceiver();
+
+    DatagramReceiver(const DatagramReceiver&) = delete;
+
+    DatagramReceiver operator=(const DatagramReceiver&) = delete;
+
+    void start();
+
+    private:
+    // returns how many datagrams were read into the batch
+    size_t receive(boost::system::error_code& error);
+
+    void wait();
+
+    // the socket was closed or the wait cancelled, every other error is worth another try
+    [[nodiscard]] bool stopped(const boost::system::error_code& error) const;
+
+    boost::asio::ip::udp::socket&  socket;
+    BufferPool&                    pool;
+    std::unique_ptr<DatagramBatch> batch;
+    Handler                        handler;
+
+    // after this many full batches the others get a turn, we continue right after them
+    constexpr static size_t max_batches = 8;
+};
+
+} // namespace yeelight
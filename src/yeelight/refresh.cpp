@@ -0,0 +1,91 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/19/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "refresh.h"
+
+#include <algorithm>
+#include <memory>
+#include <mutex>
+
+namespace yeelight
+{
+
+namespace
+{
+struct Run
+{
+    std::vector<Device*>                      devices;
+    PropertySet                               properties;
+    std::function<void(const RefreshReport&)> callback;
+    std::chrono::milliseconds                 max_age;
+
+    // the devices answer from their own strands
+    std::mutex    mutex;
+    RefreshReport report;
+    size_t        next      = 0;
+    size_t        remaining = 0;
+};
+
+// asks the next device in line, every answer starts the one after it
+void start_next(const std::shared_ptr<Run>& run)
+{
+    size_t index;
+    {
+        const auto lock = std::lock_guard(run->mutex);
+        if(run->next == run->devices.size()) return;
+        index = run->next++;
+    }
+
+    const auto handler = [run, index](Error error, const DeviceState& state) {
+        bool done;
+        {
+            const auto lock = std::lock_guard(run->mutex);
+
+            run->report.states[index] = state;
+            run->report.errors[index] = error;
+            done                      = --run->remaining == 0;
+        }
+
+        if(done)
+        {
+            if(run->callback != nullptr) run->callback(run->report);
+            return;
+        }
+        start_next(run);
+    };
+
+    run->devices[index]->get_properties(run->properties, handler, run->max_age);
+}
+
+} // namespace
+
+void refresh_all(const std::vector<Device*>&               devices,
+                 PropertySet                               properties,
+                 std::function<void(const RefreshReport&)> callback,
+                 size_t                                    max_concurrent,
+                 std::chrono::milliseconds                 max_age)
+{
+    if(devices.empty())
+    {
+        if(callback != nullptr) callback(RefreshReport());
+        return;
+    }
+
+    auto run        = std::make_shared<Run>();
+    run->devices    = devices;
+    run->properties = properties;
+    run->callback   = std::move(callback);
+    run->max_age    = max_age;
+    run->remaining  = devices.size();
+
+    run->report.states.resize(devices.size());
+    run->report.errors.resize(devices.size(), Error::none);
+
+    const auto count = std::min(devices.size(), std::max<size_t>(max_concurrent, 1));
+    for(size_t i = 0; i < count; i++) start_next(run);
+}
+
+} // namespace yeelight
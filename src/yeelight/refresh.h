@@ -0,0 +1,36 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/19/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <functional>
+#include <vector>
+
+#include "device.h"
+
+namespace yeelight
+{
+
+struct RefreshReport
+{
+    // per device, in the order they were given
+    std::vector<DeviceState> states;
+    std::vector<Error>       errors;
+};
+
+// Reads the properties of every device, at most max_concurrent of them are
+// being asked at the same time so a big fleet does not open every connection
+// at once. Devices that have fresh values answer right away without asking.
+// The callback is called once, from the strand of the last device that answered.
+void refresh_all(const std::vector<Device*>&               devices,
+                 PropertySet                               properties,
+                 std::function<void(const RefreshReport&)> callback,
+                 size_t                                    max_concurrent = 8,
+                 std::chrono::milliseconds                 max_age        = std::chrono::milliseconds(5000));
+
+} // namespace yeelight
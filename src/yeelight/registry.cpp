@@ -0,0 +1,355 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/16/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "registry.h"
+
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <nlohmann/json.h>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace
+{
+using Record = yeelight::Registry::Record;
+
+static_assert(sizeof(Record) == 96, "the record layout is part of the file format");
+static_assert(std::is_trivially_copyable_v<Record>);
+
+struct Header
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t record_size;
+};
+
+constexpr std::array<char, 8> magic   = { 'y', 'e', 'e', 'l', 'i', 'g', 'h', 't' };
+constexpr uint32_t            version = 1;
+
+// every method in the order of its capability bit, new ones go at the end
+constexpr std::array<std::string_view, 36> methods = {
+    "get_prop",       "set_ct_abx",    "set_rgb",       "set_hsv",          "set_bright",    "set_power",
+    "toggle",         "set_default",   "start_cf",      "stop_cf",          "set_scene",     "cron_add",
+    "cron_get",       "cron_del",      "set_adjust",    "set_music",        "set_name",      "bg_set_rgb",
+    "bg_set_hsv",     "bg_set_ct_abx", "bg_start_cf",   "bg_stop_cf",       "bg_set_scene",  "bg_set_default",
+    "bg_set_power",   "bg_set_bright", "bg_set_adjust", "bg_toggle",        "dev_toggle",    "adjust_bright",
+    "adjust_ct",      "adjust_color",  "bg_adjust_bright", "bg_adjust_ct", "bg_adjust_color", "udp_sess_new",
+};
+
+uint32_t checksum(const Record& record)
+{
+    // fnv-1a, only has to catch torn and garbage writes
+    const auto* data   = reinterpret_cast<const unsigned char*>(&record);
+    uint32_t    result = 2166136261u;
+
+    for(size_t i = 0; i < offsetof(Record, checksum); i++) result = (result ^ data[i]) * 16777619u;
+    return result;
+}
+
+bool same(Record lhs, Record rhs)
+{
+    lhs.last_seen = rhs.last_seen = 0;
+    lhs.checksum = rhs.checksum = 0;
+    return std::memcmp(&lhs, &rhs, sizeof(Record)) == 0;
+}
+
+Record encode(const yeelight::RegistryEntry& entry)
+{
+    Record result;
+    std::memset(&result, 0, sizeof(Record));
+
+    result.id           = entry.id;
+    result.last_seen    = std::chrono::duration_cast<std::chrono::seconds>(entry.last_seen.time_since_epoch()).count();
+    result.capabilities = entry.capabilities;
+    result.address      = entry.endpoint.address().to_v4().to_uint();
+    result.port         = entry.endpoint.port();
+
+    const auto& state  = entry.state;
+    result.powered     = state.powered;
+    result.mode        = static_cast<uint8_t>(state.mode);
+    result.brightness  = static_cast<uint32_t>(state.brightness);
+    result.temperature = static_cast<uint32_t>(state.temperature);
+    result.rgb         = state.rgb;
+    result.hue         = static_cast<uint32_t>(state.hue);
+    result.saturation  = static_cast<uint32_t>(state.saturation);
+
+    const auto length = std::min(state.name.size(), sizeof(result.name) - 1);
+    std::memcpy(result.name, state.name.data(), length);
+
+    result.checksum = checksum(result);
+    return result;
+}
+
+yeelight::RegistryEntry decode(const Record& record)
+{
+    yeelight::RegistryEntry result;
+
+    const auto address = boost::asio::ip::address_v4(record.address);
+    result.id           = record.id;
+    result.endpoint     = boost::asio::ip::tcp::endpoint(address, record.port);
+    result.last_seen    = std::chrono::system_clock::time_point(std::chrono::seconds(record.last_seen));
+    result.capabilities = record.capabilities;
+
+    auto& state       = result.state;
+    state.powered     = record.powered != 0;
+    state.mode        = static_cast<yeelight::color_mode>(record.mode);
+    state.brightness  = record.brightness;
+    state.temperature = record.temperature;
+    state.rgb         = record.rgb;
+    state.hue         = record.hue;
+    state.saturation  = record.saturation;
+    state.name        = std::string(record.name, strnlen(record.name, sizeof(record.name)));
+
+    return result;
+}
+
+bool write_all(int file, const void* data, size_t size, off_t offset)
+{
+    const auto* bytes = static_cast<const char*>(data);
+    while(size != 0)
+    {
+        const auto written = ::pwrite(file, bytes, size, offset);
+        if(written < 0) return false;
+
+        bytes += written;
+        offset += written;
+        size -= static_cast<size_t>(written);
+    }
+    return true;
+}
+
+Header make_header()
+{
+    Header header{};
+    std::copy(magic.begin(), magic.end(), header.magic);
+    header.version     = version;
+    header.record_size = sizeof(Record);
+    return header;
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+uint64_t capability_mask(std::string_view support)
+{
+    uint64_t result = 0;
+    while(not support.empty())
+    {
+        const auto space  = support.find(' ');
+        const auto method = support.substr(0, space);
+        support.remove_prefix(space == std::string_view::npos ? support.size() : space + 1);
+
+        const auto iter = std::find(methods.begin(), methods.end(), method);
+        if(iter != methods.end()) result |= uint64_t(1) << (iter - methods.begin());
+    }
+    return result;
+}
+
+bool supports(uint64_t capabilities, std::string_view method)
+{
+    const auto iter = std::find(methods.begin(), methods.end(), method);
+    return iter != methods.end() and (capabilities >> (iter - methods.begin()) & 1) != 0;
+}
+
+Registry::Registry(std::filesystem::path path) : path(std::move(path)), latest()
+{
+    file = ::open(this->path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if(file < 0) throw std::runtime_error("cannot open registry " + this->path.string() + ": " + std::strerror(errno));
+
+    load();
+}
+
+Registry::~Registry()
+{
+    if(records > latest.size()) compact();
+    ::close(file);
+}
+
+std::vector<RegistryEntry> Registry::entries() const
+{
+    std::vector<RegistryEntry> result;
+    result.reserve(latest.size());
+
+    for(const auto& [id, record] : latest) result.emplace_back(decode(record));
+    return result;
+}
+
+bool Registry::empty() const
+{
+    return latest.empty();
+}
+
+void Registry::put(const RegistryEntry& entry)
+{
+    const auto record = encode(entry);
+    const auto iter   = latest.find(entry.id);
+
+    // devices answer every search, only write again if something changed or it has been a while
+    if(iter != latest.end() and same(iter->second, record)
+       and record.last_seen - iter->second.last_seen < std::chrono::seconds(refresh).count())
+        return;
+
+    latest[entry.id] = record;
+    append(record);
+
+    if(records > 2 * latest.size() + 64) compact();
+}
+
+void Registry::compact()
+{
+    const auto temporary = std::filesystem::path(path).concat(".tmp");
+    const auto header    = make_header();
+
+    std::vector<char> buffer(sizeof(Header) + latest.size() * sizeof(Record));
+    std::memcpy(buffer.data(), &header, sizeof(Header));
+
+    auto* position = buffer.data() + sizeof(Header);
+    for(const auto& [id, record] : latest)
+    {
+        std::memcpy(position, &record, sizeof(Record));
+        position += sizeof(Record);
+    }
+
+    // write everything next to the old file and swap them, so there always is a complete one
+    const auto replacement = ::open(temporary.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if(replacement < 0 or not write_all(replacement, buffer.data(), buffer.size(), 0) or ::fsync(replacement) != 0
+       or ::rename(temporary.c_str(), path.c_str()) != 0)
+    {
+        std::cout << "cannot compact registry: " << std::strerror(errno) << '\n';
+        if(replacement >= 0) ::close(replacement);
+        return;
+    }
+
+    ::close(file);
+    file    = replacement;
+    records = latest.size();
+}
+
+bool Registry::import_json(const std::filesystem::path& legacy, uint16_t default_port)
+{
+    std::ifstream stream(legacy);
+    if(not stream.is_open()) return false;
+
+    const auto json = nlohmann::json::parse(stream, nullptr, false);
+    if(json.is_discarded() or not json.is_array()) return false;
+
+    // a hand edited file can have anything in it, like load() we keep what makes sense
+    size_t skipped = 0;
+    for(const auto& elem : json)
+    {
+        if(not elem.is_object())
+        {
+            skipped++;
+            continue;
+        }
+
+        const auto id   = elem.find("id");
+        const auto ip   = elem.find("ip");
+        const auto port = elem.find("port");
+
+        const auto has_id   = id != elem.end() and id->is_number_unsigned();
+        const auto has_ip   = ip != elem.end() and ip->is_string();
+        const auto has_port = port == elem.end() or (port->is_number_unsigned() and port->get<uint64_t>() <= 0xFFFF);
+
+        boost::system::error_code error;
+        const auto address = has_ip ? boost::asio::ip::make_address_v4(ip->get<std::string>(), error) : boost::asio::ip::address_v4();
+        if(not has_id or not has_ip or not has_port or error)
+        {
+            skipped++;
+            continue;
+        }
+
+        RegistryEntry entry;
+        entry.id       = id->get<uint64_t>();
+        entry.endpoint = boost::asio::ip::tcp::endpoint(address, port == elem.end() ? default_port : port->get<uint16_t>());
+        put(entry);
+    }
+
+    if(skipped != 0) std::cout << "skipped " << skipped << " broken devices in " << legacy << '\n';
+    return true;
+}
+
+void Registry::load()
+{
+    struct stat status;
+    if(::fstat(file, &status) != 0) throw std::runtime_error("cannot stat registry: " + std::string(std::strerror(errno)));
+
+    const auto size = static_cast<size_t>(status.st_size);
+    if(size == 0)
+    {
+        reset();
+        return;
+    }
+
+    auto* data = static_cast<const char*>(::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, file, 0));
+    if(data == MAP_FAILED) throw std::runtime_error("cannot map registry: " + std::string(std::strerror(errno)));
+
+    Header header;
+    std::memcpy(&header, data, std::min(size, sizeof(Header)));
+
+    const auto expected = make_header();
+    if(size < sizeof(Header) or std::memcmp(&header, &expected, sizeof(Header)) != 0)
+    {
+        std::cout << "registry " << path << " has an unknown format, starting over\n";
+        ::munmap(const_cast<char*>(data), size);
+        reset();
+        return;
+    }
+
+    // everything after the first broken record was written after it, so it can't be trusted either
+    auto valid = sizeof(Header);
+    for(; valid + sizeof(Record) <= size; valid += sizeof(Record))
+    {
+        Record record;
+        std::memcpy(&record, data + valid, sizeof(Record));
+        if(record.checksum != checksum(record)) break;
+
+        latest[record.id] = record;
+        records++;
+    }
+    ::munmap(const_cast<char*>(data), size);
+
+    if(valid != size)
+    {
+        std::cout << "dropping " << size - valid << " bytes of a torn write in registry " << path << '\n';
+        if(::ftruncate(file, static_cast<off_t>(valid)) != 0)
+            throw std::runtime_error("cannot truncate registry: " + std::string(std::strerror(errno)));
+    }
+}
+
+void Registry::reset()
+{
+    latest.clear();
+    records = 0;
+
+    const auto header = make_header();
+    if(::ftruncate(file, 0) != 0 or not write_all(file, &header, sizeof(Header), 0))
+        throw std::runtime_error("cannot write registry: " + std::string(std::strerror(errno)));
+}
+
+void Registry::append(const Record& record)
+{
+    // no fsync, the page cache outlives a crash of the application
+    const auto offset = static_cast<off_t>(sizeof(Header) + records * sizeof(Record));
+    if(not write_all(file, &record, sizeof(Record), offset))
+    {
+        std::cout << "cannot write registry: " << std::strerror(errno) << '\n';
+        return;
+    }
+    records++;
+}
+
+} // namespace yeelight
@@ -0,0 +1,102 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/16/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <boost/asio/ip/tcp.hpp>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <map>
+#include <string_view>
+#include <vector>
+
+#include "util.h"
+
+namespace yeelight
+{
+
+// bit i is set if the device supports the i'th method we know of
+uint64_t capability_mask(std::string_view support);
+
+bool supports(uint64_t capabilities, std::string_view method);
+
+struct RegistryEntry
+{
+    uint64_t                       id;
+    boost::asio::ip::tcp::endpoint endpoint;
+
+    std::chrono::system_clock::time_point last_seen;
+    uint64_t                              capabilities = 0;
+
+    DeviceState state;
+};
+
+// Everything we ever learned about devices, kept in a binary file of fixed
+// size records. Every change is appended right away, so a crash loses
+// nothing, and the file is rewritten with only the newest record of every
+// device once it holds too many old ones. Every record has a checksum, a
+// half written record at the end is dropped when loading.
+class Registry
+{
+    public:
+    explicit Registry(std::filesystem::path path);
+    ~Registry();
+
+    Registry(const Registry&) = delete;
+
+    Registry operator=(const Registry&) = delete;
+
+    // the newest entry of every device
+    [[nodiscard]] std::vector<RegistryEntry> entries() const;
+
+    [[nodiscard]] bool empty() const;
+
+    void put(const RegistryEntry& entry);
+
+    // rewrites the file with only the newest record of every device
+    void compact();
+
+    // reads the devices.json of older versions, returns false if there was none
+    bool import_json(const std::filesystem::path& legacy, uint16_t default_port);
+
+    // the file format, exposed so it can be checked against its size
+    struct Record
+    {
+        uint64_t id;
+        int64_t  last_seen; // seconds since the epoch
+        uint64_t capabilities;
+        uint32_t address;
+        uint16_t port;
+        uint8_t  powered;
+        uint8_t  mode;
+        uint32_t brightness;
+        uint32_t temperature;
+        uint32_t rgb;
+        uint32_t hue;
+        uint32_t saturation;
+        char     name[40]; // zero terminated, longer names are cut off
+        uint32_t checksum; // over everything before it
+    };
+
+    private:
+    void load();
+
+    void reset();
+
+    void append(const Record& record);
+
+    std::filesystem::path path;
+    int                   file = -1;
+
+    std::map<uint64_t, Record> latest;
+    size_t                     records = 0; // in the file, including the old ones
+
+    constexpr static auto refresh = std::chrono::minutes(10); // rewrite unchanged devices this often
+};
+
+} // namespace yeelight
@@ -11,165 +11,175 @@
 #include <boost/bind.hpp>
 
 #include <filesystem>
-#include <fstream>
-#include <nlohmann/json.h>
+#include <iostream>
 
 #include "scanner.h"
+#include "ssdp.h"
 
 namespace yeelight
 {
 
 
-Scanner::Scanner(std::function<void(std::unique_ptr<Device>)> handler)
-: context(std::make_shared<boost::asio::io_context>()), work(*context), listen_socket(*context),
-  scan_socket(*context), timer(*context), message(), buffer(buffer_size, '\0'), devices(), handler(std::move(handler))
+Scanner::Scanner(std::function<void(std::unique_ptr<Device>)> handler, ScannerOptions options)
+: options(std::move(options)), context(std::make_shared<boost::asio::io_context>()), strand(boost::asio::make_strand(*context)), work(*context),
+  pinger(std::make_shared<PingService>(context)),
+  connector(std::make_shared<ConnectScheduler>(context)),
+  music(std::make_shared<MusicServer>(context, this->options.music_port, this->options.music_interval)), listen_socket(strand),
+  scan_socket(strand), buffers(),
+  scan_receiver(scan_socket, buffers, [this](const Datagram& datagram) { handle_response(datagram.data); }),
+  listen_receiver(listen_socket, buffers, [this](const Datagram& datagram) { handle_response(datagram.data); }),
+  timer(strand), schedule(), message(), devices(), registry(this->options.path), handler(std::move(handler))
 {
     const auto listen_address    = boost::asio::ip::address();
-    const auto multicast_address = boost::asio::ip::address::from_string(multicast_ip);
+    const auto multicast_address = boost::asio::ip::address::from_string(this->options.multicast_ip);
+    const auto multicast_port    = this->options.multicast_port;
 
     boost::asio::ip::udp::endpoint listen_endpoint(listen_address, multicast_port);
     multicast_endpoint = boost::asio::ip::udp::endpoint(multicast_address, multicast_port);
 
+    // other ssdp listeners on this host, like a simulated fleet, can share the port.
+    // without a multicast address the searches go straight to that one host
     listen_socket.open(listen_endpoint.protocol());
+    listen_socket.set_option(boost::asio::ip::udp::socket::reuse_address(true));
     listen_socket.bind(listen_endpoint);
-    listen_socket.set_option(boost::asio::ip::multicast::join_group(multicast_address));
+    if(multicast_address.is_multicast())
+        listen_socket.set_option(boost::asio::ip::multicast::join_group(multicast_address));
 
     scan_socket.open(multicast_endpoint.protocol());
 
     message += "M-SEARCH * HTTP/1.1\r\n";
-    message += "HOST: 239.255.255.250:1982\r\n";
+    message += "HOST: " + this->options.multicast_ip + ':' + std::to_string(multicast_port) + "\r\n";
     message += "MAN: \"ssdp:discover\"\r\n";
     message += "ST: wifi_bulb";
 
+    // a device that stops answering pings may have come back with another address
+    pinger->set_listener([this](bool up) {
+        if(not up) boost::asio::post(strand, [this]() { rescan(); });
+    });
+
+    // the known devices only connect once they are used, so this is cheap
+    load_registry();
+
     async_broadcast();
-    async_receive();
-    async_listen();
+    scan_receiver.start();
+    listen_receiver.start();
 
-    read_from_file();
-    thread = std::thread([&]() { context->run(); });
+    // devices each have their own strand, so they can be handled in parallel
+    for(size_t i = 0; i < this->options.thread_count; i++) threads.emplace_back([&]() { context->run(); });
 }
 
 Scanner::~Scanner()
 {
+    pinger->set_listener(nullptr); // the devices can keep the pinger alive longer than us
     context->stop();
-    write_to_file(); // while we wait for the context to stop we cna write back to the file
-    thread.join();
+    for(auto& thread : threads) thread.join();
+    store_registry(); // only now nothing else touches the registry anymore
 }
 
-void Scanner::async_receive()
+ConnectMetrics Scanner::connect_metrics() const
 {
-    const auto handler = [&](const auto& error, auto bytes) {
-        if(error) return;
-
-        handle_response(std::string_view(buffer.data(), bytes));
-        async_receive();
-    };
+    return connector->metrics();
+}
 
-    scan_socket.async_receive(boost::asio::buffer(buffer, buffer_size), handler);
+uint64_t Scanner::broadcasts_saved() const
+{
+    return schedule.saved();
 }
 
 void Scanner::async_broadcast()
 {
     const auto handler = [&](const auto& error, [[maybe_unused]] auto bytes) {
         if(error) return;
-
-        timer.expires_from_now(boost::posix_time::seconds(1));
-        timer.async_wait([&](auto& error) {
-            if(error) return;
-            async_broadcast();
-        });
+        wait_broadcast();
     };
 
     scan_socket.async_send_to(boost::asio::buffer(message), multicast_endpoint, handler);
 }
 
-void Scanner::async_listen()
+void Scanner::wait_broadcast()
 {
-    const auto handler = [&](const auto& error, auto bytes) {
-        if(error) return;
-        handle_response(std::string_view(buffer.data(), bytes));
-        async_listen();
-    };
+    const auto delay = std::chrono::duration_cast<std::chrono::milliseconds>(schedule.next());
+
+    // only rescan() cancels the timer, in which case we search right away
+    timer.expires_from_now(boost::posix_time::milliseconds(delay.count()));
+    timer.async_wait([&](auto& error) {
+        if(error and error != boost::asio::error::operation_aborted) return;
+        async_broadcast();
+    });
+}
 
-    listen_socket.async_receive_from(boost::asio::buffer(buffer, buffer_size), sender_endpoint, handler);
+void Scanner::rescan()
+{
+    schedule.trigger();
+    timer.cancel();
 }
 
 void Scanner::handle_response(std::string_view response)
 {
-    const static std::string http_ok = "HTTP/1.1 200 OK\r\n";
-    const static std::string notify  = "NOTIFY * HTTP/1.1\r\n";
-
-    auto response_iter = response.begin();
-    if(std::equal(http_ok.begin(), http_ok.end(), response.begin()))
+    const auto advertisement = parse_advertisement(response);
+    if(not advertisement) return;
+
+    RegistryEntry entry;
+    entry.id           = advertisement->id;
+    entry.endpoint     = boost::asio::ip::tcp::endpoint(advertisement->address, advertisement->port);
+    entry.last_seen    = std::chrono::system_clock::now();
+    entry.capabilities = capability_mask(advertisement->support);
+
+    // a device we know just tells us what it is doing now, and maybe where it went.
+    // It merges on its own strand, the registry gets the whole state when it is stored
+    const auto iter = devices.find(advertisement->id);
+    if(iter != devices.end())
     {
-        response_iter += http_ok.size();
-    }
-    else if(std::equal(notify.begin(), notify.end(), response.begin()))
-    {
-        response_iter += notify.size();
-    }
-    else
-        return;
-
-    std::map<std::string, std::string> data;
-
-    while(true)
-    {
-        const auto key_end     = std::find(response_iter, response.end(), ':');
-        const auto value_start = key_end + 2;
-        if(value_start >= response.end()) return;
+        iter->second.endpoint = entry.endpoint;
+        iter->second.device->merge_advertisement(*advertisement);
 
-        const auto value_end = std::find(value_start, response.end(), '\r');
-        data.emplace(std::string(response_iter, key_end), std::string(value_start, value_end));
-
-        if(value_end + 2 >= response.end()) break;
-        response_iter = value_end + 2;
+        entry.state = iter->second.device->current_state();
+        update_state(entry.state, *advertisement);
+        registry.put(entry);
+        return;
     }
 
-    const auto index = data["Location"].find_first_of(':', 11);
-    if(index == std::string::npos) return;
+    // the device was not there when we last searched, so others may have appeared as well
+    schedule.found_new();
+    if(advertisement->notify) rescan();
 
-    const auto id   = std::stoul(data["id"], nullptr, 16);
-    const auto ip   = data["Location"].substr(11, index - 11);
+    update_state(entry.state, *advertisement);
+    registry.put(entry);
 
-    handle_new_device(id, ip);
+    handle_new_device(entry.id, entry.endpoint, std::move(entry.state));
 }
 
-void Scanner::read_from_file()
+void Scanner::load_registry()
 {
-    std::ifstream file(path);
-    const auto json = nlohmann::json::parse(file);
+    if(registry.empty() and registry.import_json(options.legacy_path, options.tcp_port))
+        std::cout << "imported devices from " << options.legacy_path << '\n';
 
-    for(const auto& elem : json)
-    {
-        handle_new_device(elem["id"], elem["ip"]);
-    }
+    for(auto& entry : registry.entries()) handle_new_device(entry.id, entry.endpoint, std::move(entry.state));
 }
 
-void Scanner::write_to_file()
+void Scanner::store_registry()
 {
-    std::ofstream file(path);
-    auto json = nlohmann::json();
-
-    size_t index = 0;
-    for(const auto& elem : devices)
+    // the devices keep their state up to date from their own notifications, the registry only sees announcements
+    for(const auto& entry : registry.entries())
     {
-        json[index]["id"] = elem.first;
-        json[index]["ip"] = elem.second;
-        index++;
+        const auto iter = devices.find(entry.id);
+        if(iter == devices.end()) continue;
+
+        auto updated  = entry;
+        updated.state = iter->second.device->current_state();
+        registry.put(updated);
     }
-    file << json << std::flush;
 }
 
-void Scanner::handle_new_device(uint64_t id, std::string ip)
+void Scanner::handle_new_device(uint64_t id, const boost::asio::ip::tcp::endpoint& endpoint, DeviceState state)
 {
-    const auto [iter, emplaced] = devices.try_emplace(id, ip);
+    const auto [iter, emplaced] = devices.try_emplace(id, Known{ endpoint, nullptr });
     if (not emplaced) return;
 
-    const auto address = boost::asio::ip::make_address(ip);
-    const auto endpoint = boost::asio::ip::tcp::endpoint(address, tcp_port);
+    auto device         = std::make_unique<Device>(context, endpoint, pinger, connector, music, std::move(state), options.idle_timeout);
+    iter->second.device = device.get();
 
-    handler(std::make_unique<Device>(context, endpoint));
+    handler(std::move(device));
 }
 
 
@@ -14,60 +14,111 @@
 #include <filesystem>
 #include <string>
 #include <map>
+#include <thread>
+#include <vector>
 
 #include "device.h"
+#include "discovery.h"
+#include "receiver.h"
+#include "registry.h"
 
 namespace yeelight
 {
 
 using namespace std::chrono_literals;
 
+// The defaults are what the bulbs use, everything can be pointed elsewhere
+// to run against simulated bulbs on loopback.
+struct ScannerOptions
+{
+    // searches go here and announcements are heard on this port, a unicast address searches that host only
+    std::string multicast_ip   = "239.255.255.250";
+    uint16_t    multicast_port = 1982;
+
+    // only used for devices of which the announcement had no port
+    uint16_t tcp_port = 55443;
+
+    // devices connect when they have something to send and close the connection after this long unused
+    std::chrono::milliseconds idle_timeout = 30s;
+
+    // where bulbs in music mode connect to, any free port if zero, and how often they get written
+    uint16_t                  music_port     = 0;
+    std::chrono::milliseconds music_interval = 33ms;
+
+    // the io context is run by this many threads
+    size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+    std::filesystem::path path = "devices.bin";
+
+    // the json file of older versions, imported once if there is no registry yet
+    std::filesystem::path legacy_path = "devices.json";
+};
 
 class Scanner
 {
     public:
-    explicit Scanner(std::function<void(std::unique_ptr<Device>)> handler);
+    // the handler is called from a network thread
+    explicit Scanner(std::function<void(std::unique_ptr<Device>)> handler,
+                     ScannerOptions                               options = ScannerOptions());
     ~Scanner();
 
-    private:
-    void async_receive();
+    [[nodiscard]] ConnectMetrics connect_metrics() const;
+
+    // how many searches the adaptive schedule did not have to send
+    [[nodiscard]] uint64_t broadcasts_saved() const;
 
+    private:
     void async_broadcast();
 
-    void async_listen();
+    void wait_broadcast();
+
+    // search again right away, the known devices may have changed
+    void rescan();
 
     void handle_response(std::string_view response);
 
-    void read_from_file();
+    void load_registry();
 
-    void write_to_file();
+    void store_registry();
 
-    void handle_new_device(uint64_t id, std::string ip);
+    void handle_new_device(uint64_t id, const boost::asio::ip::tcp::endpoint& endpoint, DeviceState state);
+
+    ScannerOptions options;
 
     std::shared_ptr<boost::asio::io_context> context;
+    boost::asio::strand<boost::asio::io_context::executor_type> strand;
     boost::asio::io_service::work work;
-    std::thread thread;
+    std::shared_ptr<PingService> pinger;
+    std::shared_ptr<ConnectScheduler> connector;
+    std::shared_ptr<MusicServer> music;
+    std::vector<std::thread> threads;
 
     boost::asio::ip::udp::socket listen_socket;
     boost::asio::ip::udp::socket scan_socket;
 
-    boost::asio::ip::udp::endpoint sender_endpoint;
     boost::asio::ip::udp::endpoint multicast_endpoint;
 
+    // every socket reads into a buffer of its own, replies and announcements come in together
+    BufferPool buffers;
+    DatagramReceiver scan_receiver;
+    DatagramReceiver listen_receiver;
+
     boost::asio::deadline_timer timer;
+    DiscoverySchedule schedule;
 
     std::string message;
-    std::string buffer;
 
-    std::filesystem::path path = "devices.json";
+    struct Known
+    {
+        boost::asio::ip::tcp::endpoint endpoint;
 
-    std::map<uint64_t, std::string> devices;
-    std::function<void(std::unique_ptr<Device>)> handler;
+        // owned by whoever got it from the handler, they outlive the scanner
+        Device* device;
+    };
 
-    constexpr static auto buffer_size = 1024;
-    constexpr static auto multicast_port = 1982;
-    constexpr static auto tcp_port = 55443;
-    constexpr static auto multicast_ip = "239.255.255.250";
+    std::map<uint64_t, Known> devices;
+    Registry registry;
+    std::function<void(std::unique_ptr<Device>)> handler;
 };
 
 } // namespace yeelight
\ No newline at end of file
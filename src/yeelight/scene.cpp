@@ -0,0 +1,142 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/6/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "scene.h"
+#include "schema.h"
+
+#include <algorithm>
+#include <mutex>
+
+namespace yeelight
+{
+
+namespace
+{
+// everything one apply() needs to fill in the report
+struct Run
+{
+    using clock = std::chrono::steady_clock;
+
+    Run(size_t size, std::vector<size_t> dispatched, std::function<void(const SceneReport&)> callback)
+    : dispatched(std::move(dispatched)), callback(std::move(callback)), start(clock::now())
+    {
+        report.written.resize(size);
+        report.acked.resize(size);
+        report.errors.resize(size, Error::none);
+    }
+
+    void finished()
+    {
+        if(--remaining != 0) return;
+
+        // only the targets that were written count, the others never left
+        const auto earlier = [&](auto lhs, auto rhs) { return report.written[lhs] < report.written[rhs]; };
+        const auto [min, max] = std::minmax_element(dispatched.begin(), dispatched.end(), earlier);
+        if(min != dispatched.end()) report.dispatch_spread = report.written[*max] - report.written[*min];
+
+        if(callback != nullptr) callback(report);
+    }
+
+    SceneReport                              report;
+    std::vector<size_t>                      dispatched; // the targets that had commands
+    std::function<void(const SceneReport&)> callback;
+
+    // the devices answer from their own strands
+    std::mutex mutex;
+
+    clock::time_point start;
+    size_t            remaining = 0;
+};
+
+} // namespace
+
+Scene::Scene(std::shared_ptr<boost::asio::io_context> context, const std::vector<Target>& targets)
+: context(std::move(context)), payloads(), targets(targets.size())
+{
+    std::vector<Payload> result;
+    result.reserve(targets.size());
+
+    for(size_t i = 0; i < targets.size(); i++)
+    {
+        const auto& target   = targets[i];
+        const auto  effect   = string_powered(target.duration);
+        const auto  duration = target.duration.count();
+
+        std::vector<Command> commands;
+
+        // a lamp that is off ignores everything else, so power goes first
+        if(target.powered == true) commands.emplace_back(make_command(method::set_power, nullptr, "on", effect, duration));
+
+        if(target.color)
+            commands.emplace_back(make_command(method::set_rgb, nullptr, dot::color::to_rgb(*target.color), effect, duration));
+        else if(target.temperature)
+            commands.emplace_back(make_command(method::set_ct_abx, nullptr, *target.temperature, effect, duration));
+
+        if(target.brightness)
+            commands.emplace_back(make_command(method::set_bright, nullptr, *target.brightness, effect, duration));
+
+        if(target.powered == false) commands.emplace_back(make_command(method::set_power, nullptr, "off", effect, duration));
+        if(target.flow != nullptr) commands.emplace_back(target.flow->command(nullptr));
+
+        // there would be no answer to wait for, and the device would connect for nothing
+        if(commands.empty()) continue;
+        result.push_back(Payload{ i, target.device, std::move(commands) });
+    }
+
+    payloads = std::make_shared<const std::vector<Payload>>(std::move(result));
+}
+
+void Scene::apply(std::function<void(const SceneReport&)> callback) const
+{
+    // all writes are issued from this one handler, each device then writes from its own strand
+    const auto handler = [payloads = payloads, targets = targets, callback = std::move(callback)]() {
+        std::vector<size_t> dispatched;
+        for(const auto& payload : *payloads) dispatched.push_back(payload.target);
+
+        auto run = std::make_shared<Run>(targets, std::move(dispatched), callback);
+
+        // every command answers once and every device writes once
+        for(const auto& payload : *payloads) run->remaining += payload.commands.size() + 1;
+        if(run->remaining == 0)
+        {
+            if(callback != nullptr) callback(run->report);
+            return;
+        }
+
+        for(const auto& payload : *payloads)
+        {
+            const auto i = payload.target;
+
+            std::vector<Command> commands = payload.commands;
+            for(auto& command : commands)
+            {
+                command.callback = [run, i](const Response& response) {
+                    const auto lock = std::lock_guard(run->mutex);
+
+                    auto& acked = run->report.acked[i];
+                    acked       = std::max(acked, Run::clock::now() - run->start);
+
+                    auto& error = run->report.errors[i];
+                    if(error == Error::none) error = response.error;
+
+                    run->finished();
+                };
+            }
+
+            const auto written = [run, i](auto) {
+                const auto lock = std::lock_guard(run->mutex);
+                run->report.written[i] = Run::clock::now() - run->start;
+                run->finished();
+            };
+
+            payload.device->dispatch(std::move(commands), written);
+        }
+    };
+
+    boost::asio::post(*context, handler);
+}
+
+} // namespace yeelight
@@ -0,0 +1,73 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/6/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <vector>
+
+#include "device.h"
+
+namespace yeelight
+{
+
+struct Target
+{
+    Device* device;
+
+    std::optional<bool>       powered;
+    std::optional<dot::color> color;
+    std::optional<size_t>     temperature;
+    std::optional<size_t>     brightness;
+
+    // started after everything else, the same flow can be shared by many targets
+    std::shared_ptr<const CompiledFlow> flow;
+
+    std::chrono::milliseconds duration = std::chrono::milliseconds(300);
+};
+
+struct SceneReport
+{
+    using duration = std::chrono::steady_clock::duration;
+
+    // per target, in the order they were given, relative to the start of the dispatch.
+    // a target without anything to send is not dispatched and keeps zero and no error
+    std::vector<duration> written; // when the commands were handed to the network
+    std::vector<duration> acked;   // when the last answer came back
+    std::vector<Error>    errors;  // the first error of any of its commands
+
+    // the difference between the first and the last device being written
+    duration dispatch_spread{};
+};
+
+// A set of device states that is applied all at once. Everything is serialized
+// when the scene is made, applying it writes every device in the same handler
+// so the lamps change as close together as possible.
+class Scene
+{
+    public:
+    Scene(std::shared_ptr<boost::asio::io_context> context, const std::vector<Target>& targets);
+
+    // the callback gets the report when every device answered or timed out
+    void apply(std::function<void(const SceneReport&)> callback = nullptr) const;
+
+    private:
+    struct Payload
+    {
+        size_t               target; // where it goes in the report
+        Device*              device;
+        std::vector<Command> commands; // without callbacks, never empty
+    };
+
+    std::shared_ptr<boost::asio::io_context> context;
+    std::shared_ptr<const std::vector<Payload>> payloads;
+    size_t                                      targets;
+};
+
+} // namespace yeelight
@@ -0,0 +1,73 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/17/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "schema.h"
+
+#include <array>
+#include <charconv>
+
+namespace yeelight
+{
+
+void append_param(std::string& output, uint64_t value)
+{
+    std::array<char, 20> buffer;
+    const auto result = std::to_chars(buffer.data(), buffer.data() + buffer.size(), value);
+    output.append(buffer.data(), result.ptr);
+}
+
+void append_param(std::string& output, std::string_view value)
+{
+    constexpr auto hex = "0123456789abcdef";
+
+    output += '"';
+    for(const auto elem : value)
+    {
+        const auto byte = static_cast<unsigned char>(elem);
+        if(elem == '"' or elem == '\\')
+        {
+            output += '\\';
+            output += elem;
+        }
+        else if(byte < 0x20)
+        {
+            output += "\\u00";
+            output += hex[byte >> 4];
+            output += hex[byte & 0xF];
+        }
+        else
+        {
+            output += elem;
+        }
+    }
+    output += '"';
+}
+
+void append_param(std::string& output, const PropertySet& properties)
+{
+    bool first = true;
+    for(size_t i = 0; i < properties.size(); i++)
+    {
+        if(not properties.test(i)) continue;
+
+        if(not first) output += ',';
+        append_param(output, property_names[i]);
+        first = false;
+    }
+}
+
+void append_frame(std::string& output, uint64_t id, const Command& command)
+{
+    output += "{\"id\":";
+    append_param(output, id);
+    output += ",\"method\":\"";
+    output += command.method;
+    output += "\",\"params\":";
+    output += command.params;
+    output += "}\r\n";
+}
+
+} // namespace yeelight
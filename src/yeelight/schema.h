@@ -0,0 +1,88 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/17/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <string_view>
+
+#include "notification.h"
+#include "queue.h"
+
+namespace yeelight
+{
+
+// A method the bulb understands together with the types of its parameters.
+// Commands can only be made from the ones below, so a misspelled method or
+// a wrong parameter does not compile instead of being rejected by the bulb.
+template <typename... Params>
+struct Method
+{
+    std::string_view name;
+    bool             coalesce; // it sets absolute state, so a newer one makes a queued one useless
+};
+
+namespace method
+{
+using Number = uint64_t;
+using Text   = std::string_view;
+
+constexpr Method<> toggle{ "toggle", false };
+constexpr Method<Number, Text, Number> set_ct_abx{ "set_ct_abx", true };
+constexpr Method<Number, Text, Number> set_rgb{ "set_rgb", true };
+constexpr Method<Number, Number, Text, Number> set_hsv{ "set_hsv", true };
+constexpr Method<Number, Text, Number> set_bright{ "set_bright", true };
+constexpr Method<Text, Text, Number> set_power{ "set_power", true };
+constexpr Method<Number, Number, Text> start_cf{ "start_cf", false };
+constexpr Method<> stop_cf{ "stop_cf", false };
+constexpr Method<Number, Number> cron_add{ "cron_add", false };
+constexpr Method<Number> cron_del{ "cron_del", false };
+constexpr Method<Text> set_name{ "set_name", true };
+constexpr Method<Number, Text, Number> set_music{ "set_music", false };
+constexpr Method<PropertySet> get_prop{ "get_prop", false };
+} // namespace method
+
+// json encoding of a single parameter, appended to the output
+void append_param(std::string& output, uint64_t value);
+
+void append_param(std::string& output, std::string_view value);
+
+// get_prop takes the names as separate parameters, in the order of the enum
+void append_param(std::string& output, const PropertySet& properties);
+
+// a whole request as it goes over the wire, {"id":1,"method":"toggle","params":[]}\r\n
+void append_frame(std::string& output, uint64_t id, const Command& command);
+
+namespace detail
+{
+// keeps the parameters from being deduced, the method decides their types
+template <typename Type>
+struct identity
+{
+    using type = Type;
+};
+} // namespace detail
+
+// serializes the parameters into the command with a single allocation
+template <typename... Params>
+Command make_command(const Method<Params...>& method,
+                     ResponseCallback         callback,
+                     typename detail::identity<Params>::type... args)
+{
+    Command result{ method.name, {}, std::move(callback), method.coalesce };
+    result.params.reserve(2 + sizeof...(Params) * 12);
+
+    result.params += '[';
+    bool first = true;
+    ((result.params += first ? "" : ",", first = false, append_param(result.params, args)), ...);
+    result.params += ']';
+
+    return result;
+}
+
+} // namespace yeelight
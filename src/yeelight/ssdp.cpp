@@ -0,0 +1,155 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/12/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "ssdp.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace
+{
+bool equals_lower(std::string_view lhs, std::string_view lower)
+{
+    const auto same = [](char a, char b) { return std::tolower(static_cast<unsigned char>(a)) == b; };
+    return lhs.size() == lower.size() and std::equal(lhs.begin(), lhs.end(), lower.begin(), same);
+}
+
+template <typename Type>
+std::optional<Type> parse_number(std::string_view value, int base = 10)
+{
+    Type result;
+    const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), result, base);
+
+    if(error != std::errc() or end != value.data() + value.size()) return std::nullopt;
+    return result;
+}
+
+std::string_view trim(std::string_view value)
+{
+    while(not value.empty() and value.front() == ' ') value.remove_prefix(1);
+    while(not value.empty() and value.back() == ' ') value.remove_suffix(1);
+    return value;
+}
+
+// "yeelight://192.168.1.239:55443"
+bool parse_location(std::string_view location, boost::asio::ip::address_v4& address, uint16_t& port)
+{
+    constexpr std::string_view scheme = "yeelight://";
+    if(location.substr(0, scheme.size()) != scheme) return false;
+    location.remove_prefix(scheme.size());
+
+    const auto colon = location.find(':');
+    if(colon == std::string_view::npos) return false;
+
+    // dotted quad by hand, asio would make a string out of it
+    auto                                    host = location.substr(0, colon);
+    boost::asio::ip::address_v4::bytes_type bytes;
+    for(size_t i = 0; i < bytes.size(); i++)
+    {
+        const auto dot  = i + 1 == bytes.size() ? host.size() : host.find('.');
+        const auto byte = parse_number<uint8_t>(host.substr(0, dot));
+        if(not byte or dot == std::string_view::npos) return false;
+
+        bytes[i] = *byte;
+        host.remove_prefix(std::min(dot + 1, host.size()));
+    }
+
+    const auto number = parse_number<uint16_t>(location.substr(colon + 1));
+    if(not number) return false;
+
+    address = boost::asio::ip::address_v4(bytes);
+    port    = *number;
+    return true;
+}
+
+} // namespace
+
+namespace yeelight
+{
+
+std::optional<Advertisement> parse_advertisement(std::string_view packet)
+{
+    constexpr std::string_view http_ok = "HTTP/1.1 200 OK\r\n";
+    constexpr std::string_view notify  = "NOTIFY * HTTP/1.1\r\n";
+
+    Advertisement result{};
+    if(packet.substr(0, http_ok.size()) == http_ok)
+    {
+        packet.remove_prefix(http_ok.size());
+        result.notify = false;
+    }
+    else if(packet.substr(0, notify.size()) == notify)
+    {
+        packet.remove_prefix(notify.size());
+        result.notify = true;
+    }
+    else
+        return std::nullopt;
+
+    bool has_id       = false;
+    bool has_location = false;
+
+    while(not packet.empty())
+    {
+        const auto line_end = packet.find("\r\n");
+        const auto line     = packet.substr(0, line_end);
+        packet.remove_prefix(line_end == std::string_view::npos ? packet.size() : line_end + 2);
+
+        const auto colon = line.find(':');
+        if(colon == std::string_view::npos) continue;
+
+        const auto key   = trim(line.substr(0, colon));
+        const auto value = trim(line.substr(colon + 1));
+
+        if(equals_lower(key, "location"))
+        {
+            has_location = parse_location(value, result.address, result.port);
+        }
+        else if(equals_lower(key, "id"))
+        {
+            // "0x000000000015243f"
+            const auto id = parse_number<uint64_t>(value.substr(std::min<size_t>(2, value.size())), 16);
+            has_id        = id.has_value() and value.substr(0, 2) == "0x";
+            result.id     = id.value_or(0);
+        }
+        else if(equals_lower(key, "model")) result.model = value;
+        else if(equals_lower(key, "fw_ver")) result.firmware = value;
+        else if(equals_lower(key, "support")) result.support = value;
+        else if(equals_lower(key, "power"))
+        {
+            if(value == "on") result.power = true;
+            else if(value == "off") result.power = false;
+        }
+        else if(equals_lower(key, "bright")) result.brightness = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "color_mode")) result.mode = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "rgb")) result.rgb = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "ct")) result.temperature = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "hue")) result.hue = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "sat")) result.saturation = parse_number<uint32_t>(value);
+        else if(equals_lower(key, "name")) result.name = value;
+    }
+
+    if(not has_id or not has_location) return std::nullopt;
+    return result;
+}
+
+void update_state(DeviceState& state, const Advertisement& advertisement)
+{
+    if(advertisement.power) state.powered = *advertisement.power;
+    if(advertisement.brightness) state.brightness = *advertisement.brightness;
+    if(advertisement.rgb) state.rgb = *advertisement.rgb;
+    if(advertisement.temperature) state.temperature = *advertisement.temperature;
+    if(advertisement.hue) state.hue = *advertisement.hue;
+    if(advertisement.saturation) state.saturation = *advertisement.saturation;
+
+    const auto mode = advertisement.mode.value_or(0);
+    if(mode >= 1 and mode <= 3) state.mode = static_cast<color_mode>(mode);
+
+    if(not advertisement.name.empty()) state.name = advertisement.name;
+}
+
+} // namespace yeelight
@@ -0,0 +1,52 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/12/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+
+#pragma once
+
+#include <boost/asio/ip/address_v4.hpp>
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+#include "util.h"
+
+namespace yeelight
+{
+
+// What a bulb tells about itself in a discovery response or NOTIFY.
+// The strings are views into the packet, it has to outlive this.
+struct Advertisement
+{
+    bool notify; // an unsolicited NOTIFY instead of an answer to our search
+
+    uint64_t                    id;
+    boost::asio::ip::address_v4 address;
+    uint16_t                    port;
+
+    std::string_view model;
+    std::string_view firmware;
+    std::string_view support; // space separated list of methods
+
+    std::string_view name;
+
+    std::optional<bool>     power;
+    std::optional<uint32_t> brightness;
+    std::optional<uint32_t> mode;
+    std::optional<uint32_t> rgb;
+    std::optional<uint32_t> temperature;
+    std::optional<uint32_t> hue;
+    std::optional<uint32_t> saturation;
+};
+
+// a single pass over the headers without copying or allocating anything,
+// returns nothing for anything that is not a valid advertisement
+std::optional<Advertisement> parse_advertisement(std::string_view packet);
+
+// overwrites the fields of the state that were in the advertisement
+void update_state(DeviceState& state, const Advertisement& advertisement);
+
+} // namespace yeelight
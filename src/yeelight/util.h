@@ -10,6 +10,13 @@
 
 #pragma once
 
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <utility/color.h>
+#include <variant>
+
 namespace yeelight
 {
 enum class color_mode
@@ -45,4 +52,25 @@ using rgb_color = dot::color;
 
 using device_color = std::variant<temperature_color, rgb_color>;
 
+// everything we know about what a device is doing right now
+struct DeviceState
+{
+    bool       powered     = false;
+    size_t     brightness  = 0;
+    color_mode mode        = color_mode::rgb;
+    size_t     temperature = 0;
+    uint32_t   rgb         = 0;
+    size_t     hue         = 0;
+    size_t     saturation  = 0;
+    bool       flowing     = false;
+
+    std::string name;
+};
+
+// the effect parameter the bulb expects for a transition of this duration
+inline std::string_view string_powered(std::chrono::milliseconds duration)
+{
+    return duration > std::chrono::milliseconds(30) ? "smooth" : "sudden";
+}
+
 } // namespace yeelight
\ No newline at end of file
@@ -0,0 +1,95 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// Runs the scanner against a small simulated fleet on loopback. Every bulb has
+// to be found within the first burst of searches, and once the set of devices
+// stays the same the schedule has to back off and skip searches.
+
+#include "fleet.h"
+
+#include "yeelight/scanner.h"
+
+#include <condition_variable>
+#include <iostream>
+#include <mutex>
+
+namespace
+{
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if(condition) return;
+
+    std::cout << "failed: " << what << '\n';
+    failures++;
+}
+
+} // namespace
+
+int main()
+{
+    bench::FleetOptions fleet_options;
+    fleet_options.bulbs     = 20;
+    fleet_options.ssdp_port = 41982;
+    fleet_options.tcp_port  = 45443;
+
+    yeelight::ScannerOptions options;
+    options.multicast_ip   = fleet_options.ssdp_ip;
+    options.multicast_port = fleet_options.ssdp_port;
+    options.thread_count   = 2;
+    options.path           = std::filesystem::temp_directory_path() / "yeelight_discovery_test.bin";
+    options.legacy_path    = std::filesystem::path();
+
+    // a registry would make every bulb known before the first search
+    std::filesystem::remove(options.path);
+
+    std::mutex                                     mutex;
+    std::condition_variable                        found;
+    std::vector<std::unique_ptr<yeelight::Device>> devices;
+
+    const auto handler = [&](std::unique_ptr<yeelight::Device> device) {
+        const auto lock = std::lock_guard(mutex);
+        devices.emplace_back(std::move(device));
+        found.notify_all();
+    };
+
+    try
+    {
+        auto fleet   = bench::FakeFleet(fleet_options);
+        auto scanner = std::make_unique<yeelight::Scanner>(handler, options);
+
+        // the burst searches five times in a bit more than a second, the bulbs answer within their window
+        {
+            auto       lock = std::unique_lock(mutex);
+            const auto all  = found.wait_for(lock, std::chrono::seconds(3), [&]() { return devices.size() == fleet_options.bulbs; });
+            check(all, "every bulb is found within the first burst");
+        }
+
+        // after the burst the interval doubles, so it soon falls behind searching every second
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(15);
+        while(scanner->broadcasts_saved() == 0 and std::chrono::steady_clock::now() < deadline)
+            std::this_thread::sleep_for(std::chrono::milliseconds(100));
+
+        const auto saved    = scanner->broadcasts_saved();
+        const auto searches = fleet.stats().searches;
+        check(saved > 0, "the schedule backs off while nothing changes");
+        check(searches < 12, "no more than the burst and the backed off searches went out");
+
+        scanner = nullptr;
+        check(devices.size() == fleet_options.bulbs, "no bulb is handed out twice");
+    }
+    catch(const std::exception& error)
+    {
+        std::cout << error.what() << '\n';
+        return 1;
+    }
+
+    std::filesystem::remove(options.path);
+
+    if(failures == 0) std::cout << "all discovery tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "yeelight/flow.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+namespace
+{
+using namespace yeelight;
+
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if(condition) return;
+
+    std::cout << "failed: " << what << '\n';
+    failures++;
+}
+
+void check_params(flow_stop_action action, const std::vector<flow_state>& states, const std::string& expected)
+{
+    const auto flow = CompiledFlow(action, states);
+    check(flow.params() == expected, "expected " + expected + " but got " + flow.params());
+}
+
+flow_state rgb(size_t ms, dot::color color, size_t brightness)
+{
+    return flow_state{ std::chrono::milliseconds(ms), color_mode::rgb, 0, color, brightness };
+}
+
+flow_state temperature(size_t ms, size_t kelvin, size_t brightness)
+{
+    return flow_state{ std::chrono::milliseconds(ms), color_mode::temperature, kelvin, dot::color(0, 0, 0), brightness };
+}
+
+flow_state sleep(size_t ms)
+{
+    return flow_state{ std::chrono::milliseconds(ms), color_mode::sleep, 0, dot::color(0, 0, 0), 0 };
+}
+
+void wire_format()
+{
+    // what the bulb expects, the documentation writes the same with spaces in between
+    check_params(flow_stop_action::stay, { rgb(1000, dot::color(255, 0, 0), 100), temperature(500, 2700, 50) },
+                 R"([2,1,"1000,1,16711680,100,500,2,2700,50"])");
+
+    check_params(flow_stop_action::recover, { temperature(1000, 2700, 100), sleep(500), temperature(1000, 5000, 1) },
+                 R"([3,0,"1000,2,2700,100,500,7,0,0,1000,2,5000,1"])");
+
+    check_params(flow_stop_action::turn_off, { rgb(50, dot::color(0, 0, 255), 1) }, R"([1,2,"50,1,255,1"])");
+}
+
+void command()
+{
+    const auto flow    = CompiledFlow(flow_stop_action::stay, { sleep(2000) });
+    const auto command = flow.command(nullptr);
+
+    check(command.method == "start_cf", "a flow is started with start_cf");
+    check(command.params == R"([1,1,"2000,7,0,0"])", "the command carries the serialized flow");
+}
+
+void invalid()
+{
+    const auto throws = [](const std::vector<flow_state>& states) {
+        try
+        {
+            CompiledFlow(flow_stop_action::stay, states);
+        }
+        catch(const std::logic_error&)
+        {
+            return true;
+        }
+        return false;
+    };
+
+    check(throws({}), "a flow without states");
+    check(throws({ rgb(49, dot::color(0, 0, 0), 100) }), "a state shorter than 50 ms");
+    check(throws({ rgb(1000, dot::color(0, 0, 0), 0) }), "a brightness of zero");
+    check(throws({ rgb(1000, dot::color(0, 0, 0), 101) }), "a brightness over 100");
+    check(not throws({ sleep(1000) }), "a sleep state does not care about its brightness");
+}
+
+void cache()
+{
+    FlowCache cache(2);
+
+    const auto states = std::vector{ rgb(1000, dot::color(255, 0, 0), 100), sleep(500) };
+    const auto first  = cache.get(flow_stop_action::stay, states);
+    const auto second = cache.get(flow_stop_action::stay, states);
+    const auto other  = cache.get(flow_stop_action::recover, states);
+
+    check(first == second, "the same flow is compiled once");
+    check(first != other, "the stop action is part of the flow");
+    check(first->hash() != other->hash(), "the stop action is part of the hash");
+    check(cache.size() == 2, "both flows are cached");
+
+    try
+    {
+        cache.get(flow_stop_action::stay, {});
+        check(false, "an invalid flow throws from the cache as well");
+    }
+    catch(const std::logic_error&)
+    {
+    }
+    check(cache.size() == 2, "an invalid flow is not cached");
+
+    cache.get(flow_stop_action::turn_off, states);
+    check(cache.size() == 1, "a full cache starts over");
+}
+
+} // namespace
+
+int main()
+{
+    wire_format();
+    command();
+    invalid();
+    cache();
+
+    if(failures == 0) std::cout << "all color flow tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
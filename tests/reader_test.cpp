@@ -0,0 +1,134 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/26/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "yeelight/reader.h"
+
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+namespace
+{
+size_t failures = 0;
+
+void check(bool condition, const char* what)
+{
+    if(condition) return;
+
+    std::cout << "failed: " << what << '\n';
+    failures++;
+}
+
+// hands the bytes to the reader the way a receive would, in as many pieces as it takes
+void feed(yeelight::LineReader& reader, const std::string& bytes)
+{
+    size_t done = 0;
+    while(done < bytes.size())
+    {
+        const auto buffer = reader.prepare();
+        const auto size   = std::min(buffer.size(), bytes.size() - done);
+
+        std::memcpy(buffer.data(), bytes.data() + done, size);
+        reader.commit(size);
+        done += size;
+    }
+}
+
+std::vector<std::string> drain(yeelight::LineReader& reader)
+{
+    std::vector<std::string> result;
+    while(const auto line = reader.next()) result.emplace_back(*line);
+    return result;
+}
+
+void split_delimiter()
+{
+    yeelight::LineReader reader;
+
+    feed(reader, R"({"id":1,"result":["ok"]})");
+    check(not reader.next(), "a line without delimiter is not complete");
+
+    feed(reader, "\r");
+    check(not reader.next(), "half a delimiter does not end the line");
+
+    feed(reader, "\n");
+    const auto lines = drain(reader);
+    check(lines == std::vector<std::string>{ R"({"id":1,"result":["ok"]})" }, "a delimiter split over two receives");
+    check(reader.pending() == 0, "nothing is left after the last line");
+}
+
+void several_in_one()
+{
+    yeelight::LineReader reader;
+
+    feed(reader, "{\"id\":1}\r\n{\"id\":2}\r\n{\"method\":\"props\"}\r\n{\"id\":");
+    const auto lines = drain(reader);
+    check(lines == std::vector<std::string>{ R"({"id":1})", R"({"id":2})", R"({"method":"props"})" },
+          "every complete line of one receive");
+    check(reader.pending() == 6, "the partial line is kept");
+
+    feed(reader, "3}\r\n");
+    check(drain(reader) == std::vector<std::string>{ R"({"id":3})" }, "the partial line is finished by the next receive");
+}
+
+void compaction()
+{
+    yeelight::LineReader reader(256);
+
+    // fill almost everything with a handed out line, so only the partial one has to move
+    const auto first   = std::string(200, 'a');
+    const auto partial = std::string(40, 'b');
+    feed(reader, first + "\r\n" + partial);
+
+    check(drain(reader) == std::vector<std::string>{ first }, "the first line before compacting");
+
+    // less than the minimum is free, so this moves the partial line to the front
+    const auto buffer = reader.prepare();
+    check(buffer.size() >= 256 - partial.size(), "compacting frees the handed out line");
+    check(reader.pending() == partial.size(), "compacting keeps the partial line");
+
+    feed(reader, "c\r\n");
+    check(drain(reader) == std::vector<std::string>{ partial + "c" }, "the partial line survives compacting");
+}
+
+void growth()
+{
+    yeelight::LineReader reader(256);
+
+    // a reply of a bulb with every property is larger than the initial buffer
+    const auto line = std::string(3000, 'x');
+    feed(reader, line + "\r\n" + "{\"id\":4}\r\n");
+
+    check(drain(reader) == std::vector<std::string>{ line, R"({"id":4})" }, "a line that does not fit grows the buffer");
+}
+
+void garbage()
+{
+    yeelight::LineReader reader;
+
+    // no bulb sends a line this long, it is dropped instead of growing forever
+    feed(reader, std::string(100 * 1024, 'x'));
+    check(reader.pending() < 64 * 1024, "a line over the maximum is dropped");
+
+    reader.clear();
+    feed(reader, "{\"id\":5}\r\n");
+    check(drain(reader) == std::vector<std::string>{ R"({"id":5})" }, "the reader works after dropping");
+}
+
+} // namespace
+
+int main()
+{
+    split_delimiter();
+    several_in_one();
+    compaction();
+    growth();
+    garbage();
+
+    if(failures == 0) std::cout << "all line reader tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+#include "yeelight/ssdp.h"
+
+#include <cstdint>
+#include <iostream>
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size);
+
+namespace
+{
+size_t failures = 0;
+
+void check(bool condition, const std::string& what)
+{
+    if(condition) return;
+
+    std::cout << "failed: " << what << '\n';
+    failures++;
+}
+
+void fuzz(const std::string& packet)
+{
+    LLVMFuzzerTestOneInput(reinterpret_cast<const uint8_t*>(packet.data()), packet.size());
+}
+
+const std::string response = "HTTP/1.1 200 OK\r\n"
+                             "Cache-Control: max-age=3600\r\n"
+                             "Location: yeelight://192.168.1.239:55443\r\n"
+                             "Server: POSIX UPnP/1.0 YGLC/1\r\n"
+                             "id: 0x000000000015243f\r\n"
+                             "model: color\r\n"
+                             "fw_ver: 18\r\n"
+                             "support: get_prop set_default set_power toggle set_bright start_cf stop_cf\r\n"
+                             "power: on\r\n"
+                             "bright: 100\r\n"
+                             "color_mode: 2\r\n"
+                             "ct: 4000\r\n"
+                             "rgb: 16711680\r\n"
+                             "hue: 100\r\n"
+                             "sat: 35\r\n"
+                             "name: my_bulb\r\n";
+
+void valid()
+{
+    const auto advertisement = yeelight::parse_advertisement(response);
+    check(advertisement.has_value(), "a complete response parses");
+    if(not advertisement) return;
+
+    check(advertisement->id == 0x15243f, "the id is hexadecimal");
+    check(advertisement->address.to_string() == "192.168.1.239", "the address comes from the location");
+    check(advertisement->port == 55443, "the port comes from the location");
+    check(advertisement->brightness == 100u and advertisement->temperature == 4000u, "the numbers are read");
+    check(advertisement->name == "my_bulb", "the name is a view into the packet");
+}
+
+void truncated()
+{
+    // every prefix, cut anywhere, in a header, a line ending or a number
+    for(size_t size = 0; size <= response.size(); size++) fuzz(response.substr(0, size));
+
+    check(not yeelight::parse_advertisement(response.substr(0, 10)), "a cut off status line");
+    check(not yeelight::parse_advertisement(response.substr(0, response.find("id:"))), "a response without id");
+}
+
+void duplicated()
+{
+    // every header twice, and once with the other value last
+    std::string twice = "HTTP/1.1 200 OK\r\n";
+    for(size_t begin = 17; begin < response.size();)
+    {
+        const auto end  = response.find("\r\n", begin) + 2;
+        const auto line = response.substr(begin, end - begin);
+        twice += line + line;
+        begin = end;
+    }
+    fuzz(twice);
+    check(yeelight::parse_advertisement(twice).has_value(), "repeated headers still parse");
+
+    const auto broken = response + "Location: yeelight://not an address\r\n";
+    fuzz(broken);
+    check(not yeelight::parse_advertisement(broken), "the last location counts, a broken one is refused");
+
+    const auto moved = response + "Location: yeelight://10.0.0.1:1\r\n";
+    const auto last  = yeelight::parse_advertisement(moved);
+    check(last and last->port == 1, "the last location counts");
+}
+
+void oversize()
+{
+    // numbers that overflow their field, and far more than a datagram holds
+    fuzz(response + "bright: 99999999999999999999\r\n");
+    fuzz(response + "id: 0x1234567890abcdef1234\r\n");
+    fuzz(response + "Location: yeelight://1.2.3.4:655350\r\n");
+    fuzz(response + "Location: yeelight://1.2.3.400:1\r\n");
+    fuzz(response + "name: " + std::string(70000, 'x') + "\r\n");
+    fuzz(response + std::string(70000, ':'));
+    fuzz(response + std::string(70000, '\r'));
+    fuzz(std::string(70000, '\0'));
+
+    check(not yeelight::parse_advertisement(response + "id: 0x1234567890abcdef1234\r\n"), "an id over 64 bits");
+    check(not yeelight::parse_advertisement(response + "Location: yeelight://1.2.3.4:655350\r\n"), "a port over 16 bits");
+
+    const auto big = yeelight::parse_advertisement(response + "bright: 99999999999999999999\r\n");
+    check(big and not big->brightness, "a brightness over 32 bits is left out");
+}
+
+void garbage()
+{
+    // a small deterministic mutator, so the corpus run covers more than the cases above
+    uint64_t state = 88172645463325252ull;
+    for(size_t round = 0; round < 20000; round++)
+    {
+        auto packet = response;
+        for(size_t i = 0; i < 1 + round % 8; i++)
+        {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+
+            const auto index = state % packet.size();
+            switch(state >> 60 & 3)
+            {
+            case 0: packet[index] = static_cast<char>(state >> 32); break;
+            case 1: packet.erase(index, state >> 40 & 15); break;
+            case 2: packet.insert(index, packet.substr(index / 2, state >> 40 & 31)); break;
+            default: packet.resize(index); break;
+            }
+            if(packet.empty()) packet = "H";
+        }
+        fuzz(packet);
+    }
+}
+
+} // namespace
+
+int main()
+{
+    valid();
+    truncated();
+    duplicated();
+    oversize();
+    garbage();
+
+    if(failures == 0) std::cout << "all discovery parser tests passed\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,42 @@
+//============================================================================
+// @author      : Thomas Dooms
+// @date        : 6/27/20
+// @copyright   : BA2 Informatica - Thomas Dooms - University of Antwerp
+//============================================================================
+
+// The libFuzzer entry for the discovery parser, built with -fsanitize=fuzzer
+// into ssdp_fuzzer, and run over a fixed corpus by ssdp_corpus_test.
+
+#include "yeelight/ssdp.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+namespace
+{
+// every view the parser hands out has to point into the packet
+void check_inside(std::string_view packet, std::string_view view)
+{
+    if(view.empty()) return;
+    if(view.data() < packet.data() or view.data() + view.size() > packet.data() + packet.size()) std::abort();
+}
+
+} // namespace
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t* data, size_t size)
+{
+    const auto packet        = std::string_view(reinterpret_cast<const char*>(data), size);
+    const auto advertisement = yeelight::parse_advertisement(packet);
+    if(not advertisement) return 0;
+
+    check_inside(packet, advertisement->model);
+    check_inside(packet, advertisement->firmware);
+    check_inside(packet, advertisement->support);
+    check_inside(packet, advertisement->name);
+
+    // whatever was in it has to be usable by the scanner
+    yeelight::DeviceState state;
+    yeelight::update_state(state, *advertisement);
+    return 0;
+}